@@ -13,6 +13,7 @@
  */
 
 #include <windows.h>
+#include <sddl.h>
 #include <sql.h>
 #include <sqlext.h>
 #include <stdio.h>
@@ -21,6 +22,254 @@
 
 static HINSTANCE hODBCInstance = NULL;
 
+/*
+ * ODBCParameter
+ */
+
+#define ODBC_PUTDATA_CHUNK	65536
+
+typedef struct _ODBCParameter
+{
+	int			data_integer;
+	double		data_double;
+	const char	*data_string;				/* Points at the Miva variable's own value, which outlives SQLExecute */
+	int			data_string_length;
+
+	SDWORD		cbData;
+} ODBCParameter;
+
+/*
+ * ODBCParameterInfo
+ */
+
+typedef struct _ODBCParameterInfo
+{
+	SQLSMALLINT	datatype;
+	SQLUINTEGER	column_size;
+	SQLSMALLINT	digits;
+	SQLSMALLINT	nullable;
+} ODBCParameterInfo;
+
+/*
+ * ODBCParameterCache
+ */
+
+typedef struct _ODBCParameterCache
+{
+	struct _ODBCParameterCache	*next;			/* Most recently used first */
+
+	char						*query;
+	int							query_length;
+	unsigned int				hash;
+
+	int							param_count;
+	ODBCParameterInfo			*params;
+} ODBCParameterCache;
+
+/*
+ * ODBCStatement
+ */
+
+typedef enum _ODBCStatementType
+{
+	ODBC_STATEMENT_QUERY,
+	ODBC_STATEMENT_VIEW,
+	ODBC_STATEMENT_FIREHOSE
+} ODBCStatementType;
+
+typedef struct _ODBCStatement
+{
+	struct _ODBCStatement	*prev;					/* Statement cache LRU list, most recently used first */
+	struct _ODBCStatement	*next;
+
+	ODBCStatementType		type;
+	char					*query;
+	int						query_length;
+	unsigned int			hash;
+
+	SQLHSTMT				hSTMT;
+
+	int						cached;
+	int						in_use;
+	int						prepared;
+	int						forwardonly;
+
+	int						param_count;			/* -1 until the parameters have been described */
+	ODBCParameterInfo		*params;
+} ODBCStatement;
+
+/*
+ * ODBCBatch
+ */
+
+typedef struct _ODBCBatchValue
+{
+	int		data_integer;
+	double	data_double;
+	int		data_string_offset;
+	int		data_string_length;
+} ODBCBatchValue;
+
+typedef struct _ODBCBatchColumn
+{
+	int		*data_integer;
+	double	*data_double;
+	char	*data_string;
+	SQLLEN	data_string_size;
+	SQLLEN	*cbData;
+} ODBCBatchColumn;
+
+typedef struct _ODBCBatch
+{
+	int				size;
+	int				rows;
+
+	ODBCStatement	*stmt;
+	int				param_count;
+
+	ODBCBatchValue	*values;				/* size * param_count entries, row-major */
+	char			*strings;
+	int				strings_length;
+	int				strings_size;
+
+	int				last_failed;			/* The last row of the most recent flush failed or was not executed */
+} ODBCBatch;
+
+/*
+ * ODBCPoolConnection
+ */
+
+typedef struct _ODBCPoolConnection
+{
+	struct _ODBCPoolConnection	*next;
+
+	char						*key;				/* path, user and password, separated by NUL characters */
+	int							key_length;
+	unsigned char				digest[ 32 ];		/* SHA-256 of the key, which cache keys use in place of the credentials */
+	int							digest_valid;
+
+	SQLHDBC						hDBC;
+
+	ULONGLONG					created;
+	ULONGLONG					released;
+} ODBCPoolConnection;
+
+/*
+ * ODBCReplica
+ *
+ * A read replica that views may be routed to.  The connection is checked out of the pool the
+ * first time a view is routed to the replica and held until the database is closed.
+ */
+
+typedef struct _ODBCReplica
+{
+	struct _ODBCReplica			*next;
+
+	char						*key;				/* Pool key, with the primary's user and password */
+	int							key_length;
+
+	ODBCPoolConnection			*connection;
+
+	int							outstanding;		/* Views currently open on the replica */
+	unsigned int				views;
+	ULONGLONG					retry;				/* Tick count before which a replica that failed to connect is skipped */
+
+	int							activities_known;
+	SQLUSMALLINT				max_activities;		/* SQL_MAX_CONCURRENT_ACTIVITIES of the replica's connection */
+	struct _ODBCDatabaseView	*firehose_view;		/* Firehose view with unread rows, if the connection allows one active statement */
+} ODBCReplica;
+
+/*
+ * ODBCWriteEntry
+ *
+ * A write-behind statement and copies of its parameter values, held in a single allocation
+ */
+
+typedef struct _ODBCWriteEntry
+{
+	char					*query;
+	int						query_length;
+
+	int						param_count;
+	char					**values;
+	int						*lengths;
+	SQLLEN					*indicators;
+} ODBCWriteEntry;
+
+/*
+ * ODBCWriteBehind
+ *
+ * A bounded single-producer, single-consumer ring of statements, drained by a worker thread on its
+ * own pooled connection.  The script's thread only advances tail and the worker only advances head.
+ */
+
+#define ODBC_WRITEBEHIND_BATCH		64
+
+typedef struct _ODBCWriteBehind
+{
+	ODBCPoolConnection		*connection;
+	SQLHSTMT				hSTMT;
+
+	HANDLE					thread;
+	HANDLE					wake;
+	HANDLE					idle;
+	volatile LONG			stop;
+
+	ODBCWriteEntry			**ring;
+	int						capacity;
+	volatile LONG			head;
+	volatile LONG			tail;
+
+	LONG					submitted;
+	volatile LONG			completed;
+	volatile LONG			failures;
+	LONG					failures_reported;
+
+	CRITICAL_SECTION		lock;					/* Guards last_error */
+	char					last_error[ 512 ];
+} ODBCWriteBehind;
+
+/*
+ * ODBCHistogram, ODBCStats
+ *
+ * Latencies are recorded in microseconds into log2 buckets: bucket 0 holds calls under 2 us and
+ * bucket n calls from 2^n up to 2^(n+1) us.  Each connection's statistics are only updated from the
+ * script's thread, the process-wide ones from every thread with interlocked operations.
+ */
+
+#define ODBC_HISTOGRAM_BUCKETS		32
+#define ODBC_SLOWLOG_QUERY			2048		/* Bytes of statement text in a slow query log entry */
+#define ODBC_SLOWLOG_PARAMETERS		16			/* Parameters listed */
+#define ODBC_SLOWLOG_VALUE			64			/* Bytes of each parameter value */
+
+typedef enum
+{
+	ODBC_PHASE_PREPARE,
+	ODBC_PHASE_EXECUTE,
+	ODBC_PHASE_FETCH,
+	ODBC_PHASE_GETDATA,
+	ODBC_PHASE_OPENVIEW,					/* Phases from here on are whole calls rather than round trips */
+	ODBC_PHASE_QUERY,
+	ODBC_PHASES
+} ODBCPhase;
+
+typedef struct _ODBCHistogram
+{
+	volatile LONG			count;
+	volatile LONG			buckets[ ODBC_HISTOGRAM_BUCKETS ];
+	volatile LONGLONG		total_us;
+	volatile LONGLONG		max_us;
+} ODBCHistogram;
+
+typedef struct _ODBCStats
+{
+	ODBCHistogram			phases[ ODBC_PHASES ];
+
+	volatile LONGLONG		round_trips;
+	volatile LONGLONG		rows;
+	volatile LONGLONG		bytes;
+} ODBCStats;
+
 /*
  * ODBCDatabase
  */
@@ -32,30 +281,112 @@ typedef struct _ODBCDatabase
 	SQLHENV		hEnv;
 	SQLHDBC		hDBC;
 
+	ODBCPoolConnection	*connection;
+	int					nopool;
+
 	mvFile		log;
+	mvFile		slowlog;				/* Statements whose prepare, execute and first fetch took longer than slowlog_threshold */
+	LONGLONG	slowlog_threshold;		/* QueryPerformanceCounter ticks */
 
 	int			autocommit;
+	int			autocommit_native;		/* Let the driver commit each statement, manual commit only inside odbc_db_transact */
+	int			autocommit_on;			/* Current SQL_ATTR_AUTOCOMMIT setting of the connection */
+	int			group_commit_rows;		/* Commit every N statements or T milliseconds instead of after each one */
+	int			group_commit_ms;
+	int			group_pending;
+	ULONGLONG	group_started;
 	int			truncate;
 	int			forwardonly;
+	int			rowset_size;
+	int			firehose;				/* Open views as forward-only, read-only cursors backed by a local row store */
+	int			firehose_store;			/* Row store limit in bytes, 0 for no limit */
+	int			store_spill;			/* Spill rows past the limit to a temporary file instead of dropping them */
+	int			materialize;			/* Fetch the whole result when the view opens and close the server cursor */
+	int			fast_skip;				/* Forward-only jumps of at least this many rows discard rows unbound, 0 to disable */
+	int			prefetch;				/* Fetch the next rowset of forward-only block cursor views in the background */
+	int			async_open;				/* Execute views with known result columns on a pooled connection in the background */
+	int			result_cache;			/* Seconds that SELECT results are kept in the process-wide result cache, 0 to disable */
+	char		cache_written[ 1024 ];	/* Tables written since the last commit, as |table|table|, see odbc_cache_committed */
+	int			cache_written_all;		/* A statement written since the last commit had an unknown target table */
+
+	ODBCWriteBehind	*writebehind;		/* Queue for MvQUERY statements outside of transactions, NULL when disabled */
+
+	ODBCStats	stats;
+	LONGLONG	statement_ticks[ ODBC_PHASES ];	/* Time spent in each phase since the current MvOPENVIEW or MvQUERY started */
+
+	struct _ODBCDatabaseView	*results_view;	/* Most recently opened view whose statement may return further result sets */
+	struct _ODBCDatabaseView	*firehose_view;	/* Firehose view with unread rows on a connection that allows one active statement */
+
+	ODBCReplica	*replicas;
+	ODBCReplica	*replica_next;			/* Round-robin position */
+	int			replica_count;
+	int			replica_routing;
+	int			replica_sticky;			/* Milliseconds after a write during which views stay on the primary */
+	ULONGLONG	last_write;
 
 	int			in_transaction;
 
+	ODBCStatement	*stmt_first;
+	ODBCStatement	*stmt_last;
+	int				stmt_count;
+	int				stmt_cache_size;
+	unsigned int	stmt_hits;
+	unsigned int	stmt_misses;
+	int				stmt_direct;			/* Run statements without input parameters with SQLExecDirect */
+	unsigned int	stmt_direct_count;
+
+	ODBCBatch		*batch;
+
+	unsigned int	allocations;
+	unsigned int	allocation_bytes;
+	unsigned int	view_allocations;			/* Allocations made by odbc_bind_columns */
+	unsigned int	view_variable_allocations;	/* Allocations the same views would take with one per variable and string buffer */
+
+	ODBCParameter	*parameters;			/* Reusable parameter scratch for odbc_execute */
+	int				parameters_size;
+
+	ODBCParameterCache	*param_cache;
+	int					param_cache_count;
+	int					param_cache_size;
+	unsigned int		param_cache_hits;
+	unsigned int		param_cache_misses;
+	int					describe_unsupported;
+
+	struct _ODBCResultShape	*shape_cache;
+	int						shape_cache_count;
+	int						shape_cache_size;
+	unsigned int			shape_cache_hits;
+	unsigned int			shape_cache_misses;
+
+	int				inline_blob;			/* Bound buffer size for TEXT/BLOB columns, 0 to always use SQLGetData */
+	int				blob_max;				/* Largest TEXT/BLOB value read with SQLGetData, longer values are truncated, 0 for no limit */
+	int				string_max;				/* Largest bound string buffer, longer values are read with SQLGetData */
+	int				string_learn;			/* Size string buffers from the widths observed by earlier views of the same query */
+	int				getdata_known;
+	SQLUINTEGER		getdata_extensions;
+	int				activities_known;
+	SQLUSMALLINT	max_activities;			/* SQL_MAX_CONCURRENT_ACTIVITIES, 0 for no limit */
+
 	char		error[ 1024 ];
 } ODBCDatabase;
 
 /*
- * ODBCParameter
+ * ODBCArena
+ *
+ * A single allocation holding a view's variables and bind buffers.  The view and each of its
+ * variables hold a reference, since variables may be cleaned up before or after the view is closed.
  */
 
-typedef struct _ODBCParameter
-{
-	int		data_integer;
-	double	data_double;
-	char	*data_string;
-	int		data_string_length;
+#define ODBC_ARENA_ALIGN( size )	( ( ( size ) + 15 ) & ~15 )
+#define ODBC_ARENA_ROWSET_MAX		( 64 * 1024 * 1024 )	/* Arena size above which block fetching falls back to single rows */
+#define ODBC_ARENA_MAX				0x3FFFFFFF				/* Largest arena, doubled for prefetch */
 
-	SDWORD	cbData;
-} ODBCParameter;
+typedef struct _ODBCArena
+{
+	int		references;
+	int		size;
+	int		used;
+} ODBCArena;
 
  /*
  * ODBCDatabaseVariable
@@ -81,10 +412,250 @@ typedef struct _ODBCDatabaseVariable
 	SDWORD						data_string_size;
 	SDWORD						cbData;
 
-	SQLHSTMT					data_blob_stmt;
+	SQLHSTMT					data_blob_stmt;			/* SQLGetData source for TEXT/BLOB columns and overflowing strings */
 	int							data_blob_col;
+	int							data_blob_row;			/* Rowset position for SQLSetPos before SQLGetData, 0 when not block fetching */
+	int							data_blob_max;
+
+	int							overflow;				/* Values longer than the bound buffer are read with SQLGetData */
+	int							data_stored;			/* data_string points into the firehose row store */
+	struct _ODBCRowStore		*data_store;			/* Row store that keeps the value once it is read, see odbc_store_keep */
+	struct _ODBCLateValue		**data_slot;
+	SDWORD						observed_size;			/* Longest value seen, -1 if none */
+
+	char						*blob;					/* Value assembled by SQLGetData for the current row, kept across reads */
+	int							blob_size;
+	int							blob_length;
+	int							blob_cached;
+	int							blob_null;
+
+	int							*rows_integer;			/* Column-wise rowset buffers, one entry per row in the rowset */
+	double						*rows_double;
+	char						*rows_string;
+	SQLLEN						*rows_cbData;
+
+	ODBCArena					*arena;
 } ODBCDatabaseVariable;
 
+/*
+ * ODBCColumnInfo
+ */
+
+typedef struct _ODBCColumnInfo
+{
+	UCHAR						name[ 256 ];
+	SWORD						name_length;
+	SWORD						sql_type;
+	UDWORD						precision;
+	SWORD						scale;
+	SWORD						nullable;
+
+	ODBCDatabaseVariableType	type;
+	SDWORD						data_string_size;		/* Declared size */
+	SDWORD						observed_size;			/* Longest value seen by views of this shape, -1 if none */
+} ODBCColumnInfo;
+
+/*
+ * ODBCResultShape
+ *
+ * The described result columns of a query and how each is bound.  Shapes are shared between the
+ * connection's metadata cache and every view opened with the same query text.
+ */
+
+typedef struct _ODBCResultShape
+{
+	struct _ODBCResultShape		*next;			/* Most recently used first */
+	int							references;
+
+	char						*query;
+	int							query_length;
+	unsigned int				hash;
+
+	int							column_count;
+	ODBCColumnInfo				*columns;
+} ODBCResultShape;
+
+/*
+ * ODBCRowStore
+ *
+ * Rows already fetched by a firehose view, so that backward navigation can be served locally.
+ * Rows are packed into chunks, each column as its indicator followed by its value.  Once the store
+ * grows past its limit the oldest chunks are either dropped, or written to a temporary file that is
+ * mapped back in a window at a time for random access.
+ *
+ * Values that did not fit their bound buffer are not read when the row is stored, unless the store
+ * is eager.  They are stored as a slot that receives a copy of the value when the script reads it,
+ * or when odbc_store_settle reads it before the cursor moves off its row.
+ */
+
+#define ODBC_STORE_CHUNK_ROWS		256
+#define ODBC_STORE_CHUNK_SIZE		65536
+#define ODBC_STORE_ALIGN( size )	( ( ( size ) + 7 ) & ~7 )
+#define ODBC_SPILL_GRANULARITY		65536			/* MapViewOfFile offsets must be multiples of the allocation granularity */
+#define ODBC_SKIP_ROWSET			1024			/* Rows discarded per fetch by odbc_skip_rows */
+#define ODBC_STORE_DEFERRED			( -16 )			/* Indicator of a value left unread by odbc_store_append */
+
+#define ODBC_ROWSET_BUFFER( view, type, buffer )	( ( type * ) ( ( char * ) ( buffer ) + ( view )->buffer_offset ) )
+
+typedef struct _ODBCRowChunk
+{
+	struct _ODBCRowChunk	*next;					/* Next newer chunk */
+
+	int						first_row;
+	int						rows;
+	int						size;
+	int						used;
+	int						offsets[ ODBC_STORE_CHUNK_ROWS ];
+} ODBCRowChunk;
+
+typedef struct _ODBCLateValue
+{
+	struct _ODBCLateValue	*next;
+	SQLLEN					cbData;					/* Followed by the value and its terminator */
+} ODBCLateValue;
+
+typedef struct _ODBCSpillChunk
+{
+	int						first_row;
+	int						rows;
+	ULONGLONG				offset;
+	DWORD					length;
+} ODBCSpillChunk;
+
+typedef struct _ODBCRowStore
+{
+	ODBCRowChunk			*first;
+	ODBCRowChunk			*last;
+
+	int						first_row;				/* Oldest row still held */
+	int						next_row;				/* Row number the next stored row will have */
+	int						complete;				/* The cursor has reached the end of the result */
+
+	int						bytes;
+	int						limit;
+	int						shared;					/* The chunks belong to a result cache entry */
+
+	int						eager;					/* Read values that overflow their buffers when the row is stored */
+	int						deferred;				/* Values stored unread */
+	ODBCLateValue			*late;					/* Copies of deferred values read later */
+
+	int						spill;
+	HANDLE					spill_file;
+	ULONGLONG				spill_size;
+	ODBCSpillChunk			*spill_chunks;
+	int						spill_count;
+	int						spill_capacity;
+
+	HANDLE					map;
+	ULONGLONG				map_size;
+	char					*window;
+	ULONGLONG				window_offset;
+	ULONGLONG				window_length;
+} ODBCRowStore;
+
+/*
+ * ODBCGenerations, ODBCSharedTags
+ *
+ * Invalidation counters of the result cache, kept both in process and in the shared mapping, and
+ * the values of those counters that a result depends on, as they were before the query executed.
+ * The result is stale once any of them has changed.
+ */
+
+#define ODBC_SHARED_TABLES			1024			/* Table generation counters, indexed by table name hash */
+#define ODBC_SHARED_TAGS			16				/* Tables tracked per result, beyond which any write invalidates it */
+
+typedef struct _ODBCGenerations
+{
+	volatile LONG			flushes;				/* Incremented by cacheflush and writes to unknown tables */
+	volatile LONG			writes;					/* Incremented by every write */
+	volatile LONG			generation[ ODBC_SHARED_TABLES ];
+} ODBCGenerations;
+
+typedef struct _ODBCSharedTags
+{
+	int						valid;					/* 0 if the counters were not captured */
+	int						count;					/* -1 if the referenced tables are unknown */
+	LONG					flushes;
+	LONG					writes;
+	int						index[ ODBC_SHARED_TAGS ];
+	LONG					generation[ ODBC_SHARED_TAGS ];
+} ODBCSharedTags;
+
+/*
+ * ODBCSharedHeader, ODBCSharedSlot
+ *
+ * Layout of the named mapping shared by every process that loads the connector.  The header is
+ * followed by fixed size slots, each holding one result, its key and its column descriptions.
+ * Slots are direct mapped by key hash and guarded by a sequence number that is odd while a
+ * process writes the slot, so readers copy a slot out and retry if the sequence changed.
+ */
+
+#define ODBC_SHARED_MAGIC			0x4D564443
+#define ODBC_SHARED_NAME			"Local\\MVDODBC_ResultCache2"
+#define ODBC_SHARED_SLOT_SIZE		( 64 * 1024 )
+#define ODBC_SHARED_HEADER_SIZE		( ( sizeof( ODBCSharedHeader ) + 4095 ) & ~4095 )
+
+typedef struct _ODBCSharedHeader
+{
+	volatile LONG			magic;					/* Set once the creating process has initialized the header */
+	int						slot_count;
+	int						slot_size;
+
+	ODBCGenerations			counters;
+} ODBCSharedHeader;
+
+typedef struct _ODBCSharedSlot
+{
+	volatile LONG			sequence;
+	unsigned int			hash;
+	ULONGLONG				expires;
+	ODBCSharedTags			tags;
+
+	int						key_length;
+	int						column_count;
+	int						rows;
+	int						chunk_count;
+	int						data_length;			/* Key, columns, then each chunk's row count, used bytes, offsets and rows */
+} ODBCSharedSlot;
+
+/*
+ * ODBCCacheEntry
+ *
+ * A complete result held in the process-wide result cache, keyed by the connection, query text and
+ * parameter values.  Views opened from the entry read its row chunks in place, so entries are
+ * reference counted and only freed once the cache and every such view have released them.
+ */
+
+#define ODBC_CACHE_BUCKETS			256
+
+typedef struct _ODBCCacheEntry
+{
+	struct _ODBCCacheEntry	*prev;					/* LRU list, most recently used first */
+	struct _ODBCCacheEntry	*next;
+	struct _ODBCCacheEntry	*bucket_next;
+
+	volatile LONG			references;
+	int						linked;
+
+	char					*key;
+	int						key_length;
+	unsigned int			hash;
+
+	char					*tables;				/* Referenced tables as "|name|name|", NULL if unknown */
+	ULONGLONG				expires;
+
+	int						bytes;
+	int						rows;
+	ODBCRowChunk			*first;
+	ODBCRowChunk			*last;
+
+	int						column_count;
+	ODBCColumnInfo			*columns;
+
+	ODBCSharedTags			tags;
+	ODBCSharedTags			local;					/* In process counters, captured when the query executed */
+} ODBCCacheEntry;
+
 /*
  * ODBCDatabaseView
  */
@@ -93,9 +664,54 @@ typedef struct _ODBCDatabaseView
 {
 	ODBCDatabase					*db;
 
+	ODBCStatement					*stmt;
 	SQLHSTMT						hSTMT;
 	
 	int								forwardonly;
+	int								firehose;
+
+	int								rowset_size;
+	int								rowset_first;			/* Row number of the first row held in the rowset buffers, 0 if empty */
+	int								rowset_next;			/* Row number the next forward-only fetch will start at */
+	SQLULEN							rowset_count;
+	SQLUSMALLINT					*rowset_status;
+
+	int								column_count;
+	struct _ODBCDatabaseVariable	**columns;
+
+	ODBCArena						*arena;
+	ODBCResultShape					*shape;
+	ODBCRowStore					*store;
+
+	HANDLE							prefetch_thread;		/* Fetches the next rowset into the other half of the arena */
+	HANDLE							prefetch_request;
+	HANDLE							prefetch_done;
+	volatile int					prefetch_stop;
+	int								prefetch_pending;
+	int								prefetch_slot;
+	SQLRETURN						prefetch_retcode;
+	SQLULEN							prefetch_fetched[ 2 ];
+	SQLULEN							bind_offset;			/* SQL_ATTR_ROW_BIND_OFFSET_PTR target */
+	int								buffer_offset;			/* Offset of the rowset buffers the script is reading */
+	int								buffer_span;			/* Distance between the two sets of rowset buffers */
+
+	int								result;					/* Position of the view's result within its statement, 0 for the first */
+	ODBCReplica						*replica;				/* Read replica the view was routed to, NULL for the primary */
+
+	ODBCCacheEntry					*cached;				/* Result cache entry the view reads, or that it populated */
+	char							*cache_key;				/* Key to cache the result under once it is complete */
+	int								cache_key_length;
+	unsigned int					cache_hash;
+	char							*cache_tables;
+	ODBCSharedTags					cache_tags;
+	ODBCSharedTags					cache_local;			/* In process counters, checked before the result is cached */
+
+	ODBCPoolConnection				*connection;			/* Connection of a view opened asynchronously */
+	HANDLE							async_thread;
+	char							*async_query;
+	int								async_query_length;
+	SQLRETURN						async_retcode;
+	char							*async_error;			/* Error of a failed asynchronous open, reported by every later access */
 
 	struct _ODBCDatabaseVariable	*recno;
 	struct _ODBCDatabaseVariable	*eof;
@@ -131,6 +747,65 @@ void odbc_log_data( ODBCDatabase *db, const char *buffer, int length )
 	}
 }
 
+/*
+ * odbc_parameter_integer
+ *
+ * Parses a non-terminated odbc_db_command parameter as a non-negative integer
+ */
+
+int odbc_parameter_integer( const char *parameter, int parameter_length )
+{
+	int i, value;
+
+	for ( i = 0, value = 0; i < parameter_length && parameter[ i ] >= '0' && parameter[ i ] <= '9'; i++ )
+	{
+		value = ( value * 10 ) + ( parameter[ i ] - '0' );
+	}
+
+	return value;
+}
+
+/*
+ * odbc_keyword
+ *
+ * Returns the length of the leading whitespace and keyword if text starts with the lowercase
+ * keyword, compared case-insensitively, otherwise 0
+ */
+
+int odbc_keyword( const char *text, int text_length, const char *keyword )
+{
+	int i, j;
+
+	for ( i = 0; i < text_length && ( text[ i ] == ' ' || text[ i ] == '\t' || text[ i ] == '\r' || text[ i ] == '\n' || text[ i ] == '(' ); i++ );
+
+	for ( j = 0; keyword[ j ]; i++, j++ )
+	{
+		if ( i == text_length || ( text[ i ] | 0x20 ) != keyword[ j ] )	return 0;
+	}
+
+	return i;
+}
+
+/*
+ * odbc_word
+ *
+ * Like odbc_keyword, but the keyword must also end a word
+ */
+
+#define ODBC_WORD_CHAR( c )		( ( ( c ) >= 'a' && ( c ) <= 'z' ) || ( ( c ) >= 'A' && ( c ) <= 'Z' ) || ( ( c ) >= '0' && ( c ) <= '9' ) || ( c ) == '_' )
+
+int odbc_word( const char *text, int text_length, const char *keyword )
+{
+	int length;
+
+	if ( ( length = odbc_keyword( text, text_length, keyword ) ) == 0 || ( length < text_length && ODBC_WORD_CHAR( text[ length ] ) ) )
+	{
+		return 0;
+	}
+
+	return length;
+}
+
 /*
  * odbc_error
  */
@@ -198,491 +873,6285 @@ int odbc_error( ODBCDatabase *db, const char *prefix, SQLHANDLE handle, SQLSMALL
 }
 
 /*
- * odbc_execute
+ * odbc_allocate
+ *
+ * mvProgram_Allocate, counted against the connection's allocation statistics
  */
 
-int odbc_execute( ODBCDatabase *db, SQLHSTMT hSTMT, mvVariableList input )
+void *odbc_allocate( ODBCDatabase *db, int size )
 {
-	SQLRETURN retcode;
-	SQLPOINTER pToken;
-	SQLSMALLINT	datatype;
-	SQLUINTEGER	column_size;
-	SQLSMALLINT digits;
-	SQLSMALLINT nullable;
-	SQLSMALLINT	bind_count;
-	mvVariable variable;
-	const char *value_string;
-	int value_string_length;
-	int param, numparams;
-	ODBCParameter *parameter_data;
+	db->allocations++;
+	db->allocation_bytes += size;
 
-	numparams		= mvVariableList_Entries( input );
-	parameter_data	= ( ODBCParameter * ) mvProgram_Allocate( NULL, sizeof( ODBCParameter ) * numparams );
-	memset( parameter_data, 0, sizeof( ODBCParameter ) * numparams );
+	return mvProgram_Allocate( NULL, size );
+}
 
-	if ( SQLNumParams( hSTMT, &bind_count ) != SQL_SUCCESS )
-	{	
-		odbc_error( db, "SQLNumParams: ", hSTMT, SQL_HANDLE_STMT );
-		goto error;
-	}
+/*
+ * Statistics
+ */
 
-	if ( bind_count != numparams ) 
-	{
-		odbc_log( db, "*** Input parameter count mismatch: Found %d, expected %d\n", numparams, bind_count );
-		sprintf( db->error, "Input parameter count mismatch: Found %d, expected %d", numparams, bind_count );
-		goto error;
-	}
-	
-	for ( param = 0, variable = mvVariableList_First( input ); variable; param++, variable = mvVariableList_Next( input ) )
-	{
-		datatype	= 0;
-		column_size	= 0;
-		digits		= 0;
-		nullable	= 0;
+static ODBCStats			odbc_stats;					/* Process-wide */
+static LONGLONG				odbc_timer_frequency	= 1;
 
-		if ( SQLDescribeParam( hSTMT, param + 1, &datatype, &column_size, &digits, &nullable ) != SQL_SUCCESS )
-		{
-			odbc_log( db, "+++ SQLDescribeParam for parameter %d failed, defaulting to character bind\n", param + 1 );
+/*
+ * odbc_timer
+ *
+ * Returns the monotonic QueryPerformanceCounter value, for odbc_stats_record
+ */
 
-				datatype	= SQL_CHAR;
-			column_size	= -1;
-		}
+LONGLONG odbc_timer( void )
+{
+	LARGE_INTEGER now;
 
-		odbc_log( db, "--- Parameter %d: datatype = %d, column_size = %d, digits = %d, nullable = %d\n",
-				  param + 1,
-				  datatype,
-				  column_size,
-				  digits,
-				  nullable );
+	QueryPerformanceCounter( &now );
+	return now.QuadPart;
+}
+
+/*
+ * odbc_stats_record
+ *
+ * Adds the time since start to the phase's histograms for the connection and the process
+ */
+
+void odbc_stats_record( ODBCDatabase *db, ODBCPhase phase, LONGLONG start )
+{
+	int bucket;
+	LONGLONG ticks, us, max_us;
+	ODBCHistogram *histogram;
+
+	ticks	= odbc_timer() - start;
+	us		= ( ticks * 1000000 ) / odbc_timer_frequency;
+
+	db->statement_ticks[ phase ] += ticks;
+
+	for ( bucket = 0; bucket < ODBC_HISTOGRAM_BUCKETS - 1 && ( us >> ( bucket + 1 ) ); bucket++ );
+
+	histogram = &db->stats.phases[ phase ];
+
+	histogram->count++;
+	histogram->buckets[ bucket ]++;
+	histogram->total_us	+= us;
+	if ( us > histogram->max_us )	histogram->max_us = us;
+	if ( phase < ODBC_PHASE_OPENVIEW )	db->stats.round_trips++;
+
+	histogram = &odbc_stats.phases[ phase ];
+
+	InterlockedIncrement( &histogram->count );
+	InterlockedIncrement( &histogram->buckets[ bucket ] );
+	InterlockedExchangeAdd64( &histogram->total_us, us );
+
+	while ( us > ( max_us = histogram->max_us ) && InterlockedCompareExchange64( &histogram->max_us, us, max_us ) != max_us );
+
+	if ( phase < ODBC_PHASE_OPENVIEW )	InterlockedIncrement64( &odbc_stats.round_trips );
+}
+
+/*
+ * odbc_stats_transfer
+ */
+
+void odbc_stats_transfer( ODBCDatabase *db, LONGLONG rows, LONGLONG bytes )
+{
+	db->stats.rows	+= rows;
+	db->stats.bytes	+= bytes;
+
+	InterlockedExchangeAdd64( &odbc_stats.rows, rows );
+	InterlockedExchangeAdd64( &odbc_stats.bytes, bytes );
+}
+
+/*
+ * odbc_stats_fetched
+ *
+ * Counts the rows just fetched into the view's rowset buffers and the bytes of their bound values
+ */
+
+void odbc_stats_fetched( ODBCDatabaseView *view, int count )
+{
+	int i, index;
+	LONGLONG bytes;
+	SQLLEN cbData;
+	ODBCDatabaseVariable *odbcvar;
+
+	for ( i = 0, bytes = 0; i < view->column_count; i++ )
+	{
+		odbcvar = view->columns[ i ];
+
+		if ( odbcvar->rows_cbData == NULL )
+		{
+			continue;
+		}
+
+		for ( index = 0; index < count; index++ )
+		{
+			if ( ( cbData = ODBC_ROWSET_BUFFER( view, SQLLEN, odbcvar->rows_cbData )[ index ] ) > 0 )
+			{
+				bytes += ( odbcvar->type == ODBC_INTEGER ) ? sizeof( int ) : ( odbcvar->type == ODBC_DOUBLE ) ? sizeof( double ) : cbData;
+			}
+		}
+	}
+
+	odbc_stats_transfer( view->db, count, bytes );
+}
+
+/*
+ * odbc_stats_json
+ *
+ * Formats statistics as a JSON object, returning its length
+ */
+
+int odbc_stats_json( char *buffer, ODBCStats *stats )
+{
+	int i, phase, length;
+	static const char *names[ ODBC_PHASES ] = { "prepare", "execute", "fetch", "getdata", "openview", "query" };
+
+	length = sprintf( buffer, "{\"round_trips\":%I64d,\"rows\":%I64d,\"bytes\":%I64d,\"phases\":{", stats->round_trips, stats->rows, stats->bytes );
+
+	for ( phase = 0; phase < ODBC_PHASES; phase++ )
+	{
+		length += sprintf( &buffer[ length ], "%s\"%s\":{\"count\":%ld,\"total_us\":%I64d,\"max_us\":%I64d,\"buckets\":[",
+						   phase ? "," : "",
+						   names[ phase ],
+						   stats->phases[ phase ].count,
+						   stats->phases[ phase ].total_us,
+						   stats->phases[ phase ].max_us );
+
+		for ( i = 0; i < ODBC_HISTOGRAM_BUCKETS; i++ )
+		{
+			length += sprintf( &buffer[ length ], "%s%ld", i ? "," : "", stats->phases[ phase ].buckets[ i ] );
+		}
+
+		length += sprintf( &buffer[ length ], "]}" );
+	}
+
+	length += sprintf( &buffer[ length ], "}}" );
+	return length;
+}
+
+/*
+ * odbc_slowlog
+ *
+ * Writes the statement to the slow query log if its prepare, execute and first fetch took longer than
+ * the threshold, with the time of each phase, the rows fetched and the first bytes of each parameter
+ */
+
+void odbc_slowlog( ODBCDatabase *db, const char *kind, const char *query, int query_length, mvVariableList list, int result, LONGLONG rows )
+{
+	int length, param, value_length;
+	const char *value;
+	mvVariable variable;
+	SYSTEMTIME now;
+	char buffer[ 8192 ];
+
+	if ( db->statement_ticks[ ODBC_PHASE_PREPARE ] + db->statement_ticks[ ODBC_PHASE_EXECUTE ] + db->statement_ticks[ ODBC_PHASE_FETCH ] <= db->slowlog_threshold )
+	{
+		return;
+	}
+
+	GetLocalTime( &now );
+
+	length = sprintf( buffer, "*** Slow %s at %04d-%02d-%02d %02d:%02d:%02d.%03d: total = %.3f ms, prepare = %.3f ms, execute = %.3f ms, fetch = %.3f ms, getdata = %.3f ms, rows = %d, %s\n"
+							  "%.*s%s\n",
+					  kind,
+					  now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond, now.wMilliseconds,
+					  ( db->statement_ticks[ ODBC_PHASE_OPENVIEW ] + db->statement_ticks[ ODBC_PHASE_QUERY ] ) * 1000.0 / odbc_timer_frequency,
+					  db->statement_ticks[ ODBC_PHASE_PREPARE ] * 1000.0 / odbc_timer_frequency,
+					  db->statement_ticks[ ODBC_PHASE_EXECUTE ] * 1000.0 / odbc_timer_frequency,
+					  db->statement_ticks[ ODBC_PHASE_FETCH ] * 1000.0 / odbc_timer_frequency,
+					  db->statement_ticks[ ODBC_PHASE_GETDATA ] * 1000.0 / odbc_timer_frequency,
+					  ( int ) rows,
+					  result ? "succeeded" : "failed",
+					  query_length < ODBC_SLOWLOG_QUERY ? query_length : ODBC_SLOWLOG_QUERY, query,
+					  query_length > ODBC_SLOWLOG_QUERY ? "..." : "" );
+
+	if ( list && mvVariableList_Entries( list ) )
+	{
+		length += sprintf( &buffer[ length ], "+++ Parameters (%d):", mvVariableList_Entries( list ) );
+
+		for ( param = 0, variable = mvVariableList_First( list ); variable && param < ODBC_SLOWLOG_PARAMETERS; param++, variable = mvVariableList_Next( list ) )
+		{
+			value	= mvVariable_Value( variable, &value_length );
+			length	+= sprintf( &buffer[ length ], "%s %d = '%.*s'%s",
+								param ? "," : "",
+								param + 1,
+								value_length < ODBC_SLOWLOG_VALUE ? value_length : ODBC_SLOWLOG_VALUE, value,
+								value_length > ODBC_SLOWLOG_VALUE ? "..." : "" );
+		}
+
+		length += sprintf( &buffer[ length ], "%s\n", variable ? ", ..." : "" );
+	}
+
+	mvFile_Write( db->slowlog, buffer, length );
+}
+
+/*
+ * odbc_arena_create
+ */
+
+ODBCArena *odbc_arena_create( ODBCDatabase *db, int size, int references )
+{
+	ODBCArena *arena;
+
+	arena				= ( ODBCArena * ) odbc_allocate( db, ODBC_ARENA_ALIGN( sizeof( ODBCArena ) ) + size );
+	arena->references	= references;
+	arena->size			= size;
+	arena->used			= 0;
+
+	return arena;
+}
+
+/*
+ * odbc_arena_carve
+ */
+
+void *odbc_arena_carve( ODBCArena *arena, int size )
+{
+	char *data;
+
+	data			= ( char * ) arena + ODBC_ARENA_ALIGN( sizeof( ODBCArena ) ) + arena->used;
+	arena->used		+= ODBC_ARENA_ALIGN( size );
+
+	return data;
+}
+
+/*
+ * odbc_arena_release
+ */
+
+void odbc_arena_release( ODBCArena *arena )
+{
+	if ( --arena->references == 0 )
+	{
+		mvProgram_Free( NULL, arena );
+	}
+}
+
+/*
+ * odbc_statement_hash
+ */
+
+unsigned int odbc_statement_hash( const char *query, int query_length )
+{
+	int i;
+	unsigned int hash;
+
+	for ( i = 0, hash = 2166136261U; i < query_length; i++ )
+	{
+		hash = ( hash ^ ( unsigned char ) query[ i ] ) * 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+ * Result cache generations
+ *
+ * Counters of the result cache, in process and in the shared tier's mapping, advanced when a table
+ * is written and again when the write commits, see odbc_cache_committed
+ */
+
+static ODBCGenerations		odbc_generations;
+static ODBCGenerations		*odbc_shared_generations	= NULL;		/* Counters in the shared tier, NULL when not attached */
+
+/*
+ * odbc_generations_capture
+ *
+ * Records the current values of the counters for the tables listed in a cache_tables string
+ */
+
+void odbc_generations_capture( ODBCGenerations *counters, const char *tables, ODBCSharedTags *tags )
+{
+	const char *name, *end;
+
+	memset( tags, 0, sizeof( ODBCSharedTags ) );
+
+	tags->valid		= 1;
+	tags->flushes	= counters->flushes;
+	tags->writes	= counters->writes;
+
+	if ( tables == NULL )
+	{
+		tags->count = -1;
+		return;
+	}
+
+	for ( name = tables + 1; *name; name = end + 1 )
+	{
+		end = strchr( name, '|' );
+
+		if ( tags->count == ODBC_SHARED_TAGS )
+		{
+			tags->count = -1;
+			return;
+		}
+
+		tags->index[ tags->count ]		= odbc_statement_hash( name, ( int ) ( end - name ) ) % ODBC_SHARED_TABLES;
+		tags->generation[ tags->count ]	= counters->generation[ tags->index[ tags->count ] ];
+		tags->count++;
+	}
+}
+
+/*
+ * odbc_generations_current
+ *
+ * Returns 0 if a write has advanced any of the counters captured in tags
+ */
+
+int odbc_generations_current( ODBCGenerations *counters, ODBCSharedTags *tags )
+{
+	int i;
+
+	if ( !tags->valid )							return 1;
+	if ( counters->flushes != tags->flushes )	return 0;
+	if ( tags->count < 0 )						return counters->writes == tags->writes;
+
+	for ( i = 0; i < tags->count; i++ )
+	{
+		if ( counters->generation[ tags->index[ i ] ] != tags->generation[ i ] )	return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_generations_advance
+ *
+ * Advances the generation of a written table, or the flush count if the table is not known
+ */
+
+void odbc_generations_advance( ODBCGenerations *counters, const char *table )
+{
+	InterlockedIncrement( &counters->writes );
+
+	if ( table )	InterlockedIncrement( &counters->generation[ odbc_statement_hash( table, strlen( table ) ) % ODBC_SHARED_TABLES ] );
+	else			InterlockedIncrement( &counters->flushes );
+}
+
+/*
+ * odbc_statement_unlink
+ */
+
+void odbc_statement_unlink( ODBCDatabase *db, ODBCStatement *stmt )
+{
+	if ( stmt->prev )	stmt->prev->next	= stmt->next;
+	else				db->stmt_first		= stmt->next;
+
+	if ( stmt->next )	stmt->next->prev	= stmt->prev;
+	else				db->stmt_last		= stmt->prev;
+
+	stmt->prev		= NULL;
+	stmt->next		= NULL;
+	stmt->cached	= 0;
+
+	db->stmt_count--;
+}
+
+/*
+ * odbc_statement_free
+ */
+
+void odbc_statement_free( ODBCStatement *stmt )
+{
+	if ( stmt->hSTMT )	SQLFreeStmt( stmt->hSTMT, SQL_DROP );
+	if ( stmt->params )	mvProgram_Free( NULL, stmt->params );
+
+	mvProgram_Free( NULL, stmt->query );
+	mvProgram_Free( NULL, stmt );
+}
+
+/*
+ * odbc_statement_trim
+ *
+ * Drops idle statements from the end of the LRU list until the cache fits within limit entries
+ */
+
+void odbc_statement_trim( ODBCDatabase *db, int limit )
+{
+	ODBCStatement *stmt, *prev;
+
+	for ( stmt = db->stmt_last; stmt && db->stmt_count > limit; stmt = prev )
+	{
+		prev = stmt->prev;
+
+		if ( !stmt->in_use )
+		{
+			odbc_statement_unlink( db, stmt );
+			odbc_statement_free( stmt );
+		}
+	}
+}
+
+/*
+ * odbc_statement_create
+ *
+ * Allocates an uncached statement on hDBC
+ */
+
+ODBCStatement *odbc_statement_create( ODBCDatabase *db, SQLHDBC hDBC, ODBCStatementType type, const char *query, int query_length )
+{
+	ODBCStatement *stmt;
+
+	stmt				= ( ODBCStatement * ) odbc_allocate( db, sizeof( ODBCStatement ) );
+	memset( stmt, 0, sizeof( ODBCStatement ) );
+
+	stmt->type			= type;
+	stmt->hash			= odbc_statement_hash( query, query_length );
+	stmt->query			= ( char * ) odbc_allocate( db, query_length + 1 );
+	stmt->query_length	= query_length;
+	stmt->in_use		= 1;
+	stmt->param_count	= -1;
+
+	memcpy( stmt->query, query, query_length );
+	stmt->query[ query_length ] = '\0';
+
+	if ( SQLAllocStmt( hDBC, &( stmt->hSTMT ) ) != SQL_SUCCESS )
+	{
+		odbc_error( db, "SQLAllocStmt: ", hDBC, SQL_HANDLE_DBC );
+
+		stmt->hSTMT = SQL_NULL_HSTMT;
+		odbc_statement_free( stmt );
+
+		return NULL;
+	}
+
+	return stmt;
+}
+
+/*
+ * odbc_statement_acquire
+ *
+ * Returns an idle cached statement for the query text if there is one, otherwise allocates a new,
+ * unprepared statement.  The caller prepares the statement if stmt->prepared is not set.
+ */
+
+ODBCStatement *odbc_statement_acquire( ODBCDatabase *db, ODBCStatementType type, const char *query, int query_length )
+{
+	unsigned int hash;
+	ODBCStatement *stmt;
+
+	hash = odbc_statement_hash( query, query_length );
+
+	for ( stmt = db->stmt_first; stmt; stmt = stmt->next )
+	{
+		if ( !stmt->in_use && stmt->type == type && stmt->hash == hash &&
+			 stmt->query_length == query_length && !memcmp( stmt->query, query, query_length ) )
+		{
+			odbc_statement_unlink( db, stmt );
+
+			stmt->next			= db->stmt_first;
+			stmt->cached		= 1;
+			stmt->in_use		= 1;
+
+			if ( db->stmt_first )	db->stmt_first->prev	= stmt;
+			else					db->stmt_last			= stmt;
+
+			db->stmt_first		= stmt;
+			db->stmt_count++;
+			db->stmt_hits++;
+
+			odbc_log( db, "--- Statement cache hit\n" );
+			return stmt;
+		}
+	}
+
+	if ( db->stmt_cache_size )
+	{
+		db->stmt_misses++;
+	}
+
+	return odbc_statement_create( db, db->hDBC, type, query, query_length );
+}
+
+/*
+ * odbc_statement_release
+ *
+ * Returns a statement to the cache, or drops it if caching is disabled or the statement is not
+ * in a reusable state.
+ */
+
+void odbc_statement_release( ODBCDatabase *db, ODBCStatement *stmt, int reusable )
+{
+	stmt->in_use = 0;
+
+	if ( reusable && stmt->prepared && db->stmt_cache_size )
+	{
+		if ( ( SQLFreeStmt( stmt->hSTMT, SQL_CLOSE )		!= SQL_ERROR ) &&
+			 ( SQLFreeStmt( stmt->hSTMT, SQL_UNBIND )		!= SQL_ERROR ) &&
+			 ( SQLFreeStmt( stmt->hSTMT, SQL_RESET_PARAMS )	!= SQL_ERROR ) )
+		{
+			if ( !stmt->cached )
+			{
+				stmt->next		= db->stmt_first;
+				stmt->cached	= 1;
+
+				if ( db->stmt_first )	db->stmt_first->prev	= stmt;
+				else					db->stmt_last			= stmt;
+
+				db->stmt_first	= stmt;
+				db->stmt_count++;
+			}
+
+			odbc_statement_trim( db, db->stmt_cache_size );
+			return;
+		}
+	}
+
+	if ( stmt->cached )
+	{
+		odbc_statement_unlink( db, stmt );
+	}
+
+	odbc_statement_free( stmt );
+}
+
+/*
+ * odbc_parameters
+ *
+ * Returns the connection's parameter scratch, cleared and large enough for count parameters
+ */
+
+ODBCParameter *odbc_parameters( ODBCDatabase *db, int count )
+{
+	if ( count > db->parameters_size )
+	{
+		if ( db->parameters )	mvProgram_Free( NULL, db->parameters );
+
+		db->parameters_size	= count > 16 ? count : 16;
+		db->parameters		= ( ODBCParameter * ) odbc_allocate( db, sizeof( ODBCParameter ) * db->parameters_size );
+	}
+
+	memset( db->parameters, 0, sizeof( ODBCParameter ) * count );
+	return db->parameters;
+}
+
+/*
+ * odbc_param_cache_trim
+ */
+
+void odbc_param_cache_trim( ODBCDatabase *db, int limit )
+{
+	int count;
+	ODBCParameterCache *entry, **link;
+
+	for ( count = 0, link = &db->param_cache; ( entry = *link ) != NULL; )
+	{
+		if ( count < limit )
+		{
+			link = &entry->next;
+			count++;
+
+			continue;
+		}
+
+		*link = entry->next;
+
+		mvProgram_Free( NULL, entry->query );
+		mvProgram_Free( NULL, entry->params );
+		mvProgram_Free( NULL, entry );
+
+		db->param_cache_count--;
+	}
+}
+
+/*
+ * odbc_param_cache_lookup
+ *
+ * Copies cached parameter descriptions for the statement's query text into the statement
+ */
+
+int odbc_param_cache_lookup( ODBCDatabase *db, ODBCStatement *stmt )
+{
+	ODBCParameterCache *entry, **link;
+
+	if ( db->param_cache_size == 0 )
+	{
+		return 0;
+	}
+
+	for ( link = &db->param_cache; ( entry = *link ) != NULL; link = &entry->next )
+	{
+		if ( entry->hash == stmt->hash && entry->query_length == stmt->query_length && !memcmp( entry->query, stmt->query, stmt->query_length ) )
+		{
+			*link				= entry->next;
+			entry->next			= db->param_cache;
+			db->param_cache		= entry;
+
+			stmt->params		= ( ODBCParameterInfo * ) odbc_allocate( db, sizeof( ODBCParameterInfo ) * ( entry->param_count + 1 ) );
+			stmt->param_count	= entry->param_count;
+
+			memcpy( stmt->params, entry->params, sizeof( ODBCParameterInfo ) * entry->param_count );
+
+			db->param_cache_hits++;
+			return 1;
+		}
+	}
+
+	db->param_cache_misses++;
+	return 0;
+}
+
+/*
+ * odbc_param_cache_store
+ */
+
+void odbc_param_cache_store( ODBCDatabase *db, ODBCStatement *stmt )
+{
+	ODBCParameterCache *entry;
+
+	if ( db->param_cache_size == 0 )
+	{
+		return;
+	}
+
+	entry				= ( ODBCParameterCache * ) odbc_allocate( db, sizeof( ODBCParameterCache ) );
+	entry->query		= ( char * ) odbc_allocate( db, stmt->query_length + 1 );
+	entry->query_length	= stmt->query_length;
+	entry->hash			= stmt->hash;
+	entry->param_count	= stmt->param_count;
+	entry->params		= ( ODBCParameterInfo * ) odbc_allocate( db, sizeof( ODBCParameterInfo ) * ( stmt->param_count + 1 ) );
+
+	memcpy( entry->query, stmt->query, stmt->query_length + 1 );
+	memcpy( entry->params, stmt->params, sizeof( ODBCParameterInfo ) * stmt->param_count );
+
+	entry->next			= db->param_cache;
+	db->param_cache		= entry;
+	db->param_cache_count++;
+
+	odbc_param_cache_trim( db, db->param_cache_size );
+}
+
+/*
+ * odbc_describe_unsupported
+ *
+ * Returns 1 if a failed SQLDescribeParam indicates that the driver does not implement it at all
+ */
+
+int odbc_describe_unsupported( SQLHSTMT hSTMT )
+{
+	SQLINTEGER native;
+	SQLCHAR state[ 6 ];
+	SQLCHAR text[ 256 ];
+	SQLSMALLINT text_length;
+
+	if ( SQLGetDiagRec( SQL_HANDLE_STMT, hSTMT, 1, state, &native, text, sizeof( text ), &text_length ) != SQL_SUCCESS )
+	{
+		return 0;
+	}
+
+	return !strcmp( ( const char * ) state, "IM001" ) || !strcmp( ( const char * ) state, "HYC00" );
+}
+
+/*
+ * odbc_describe_parameters
+ *
+ * Verifies the input parameter count and describes the statement's parameters, unless a previous
+ * execution of the statement already did so.
+ */
+
+int odbc_describe_parameters( ODBCDatabase *db, ODBCStatement *stmt, int numparams )
+{
+	SQLSMALLINT	datatype;
+	SQLUINTEGER	column_size;
+	SQLSMALLINT digits;
+	SQLSMALLINT nullable;
+	SQLSMALLINT	bind_count;
+	int param;
+
+	if ( stmt->param_count == -1 )
+	{
+		odbc_param_cache_lookup( db, stmt );
+	}
+
+	if ( stmt->param_count == -1 )
+	{
+		if ( SQLNumParams( stmt->hSTMT, &bind_count ) != SQL_SUCCESS )
+		{	
+			return odbc_error( db, "SQLNumParams: ", stmt->hSTMT, SQL_HANDLE_STMT );
+		}
+	}
+	else
+	{
+		bind_count = ( SQLSMALLINT ) stmt->param_count;
+	}
+
+	if ( bind_count != numparams ) 
+	{
+		odbc_log( db, "*** Input parameter count mismatch: Found %d, expected %d\n", numparams, bind_count );
+		sprintf( db->error, "Input parameter count mismatch: Found %d, expected %d", numparams, bind_count );
+		return 0;
+	}
+
+	if ( stmt->param_count != -1 )
+	{
+		return 1;
+	}
+
+	stmt->params = ( ODBCParameterInfo * ) odbc_allocate( db, sizeof( ODBCParameterInfo ) * ( numparams + 1 ) );
+
+	for ( param = 0; param < numparams; param++ )
+	{
+		datatype	= 0;
+		column_size	= 0;
+		digits		= 0;
+		nullable	= 0;
+
+		if ( db->describe_unsupported )
+		{
+			datatype	= SQL_CHAR;
+			column_size	= -1;
+		}
+		else if ( SQLDescribeParam( stmt->hSTMT, param + 1, &datatype, &column_size, &digits, &nullable ) != SQL_SUCCESS )
+		{
+			odbc_log( db, "+++ SQLDescribeParam for parameter %d failed, defaulting to character bind\n", param + 1 );
+
+			if ( odbc_describe_unsupported( stmt->hSTMT ) )
+			{
+				odbc_log( db, "+++ SQLDescribeParam is not supported by the driver, skipping it for this connection\n" );
+				db->describe_unsupported = 1;
+			}
+
+			datatype	= SQL_CHAR;
+			column_size	= -1;
+			digits		= 0;
+			nullable	= 0;
+		}
+
+		stmt->params[ param ].datatype		= datatype;
+		stmt->params[ param ].column_size	= column_size;
+		stmt->params[ param ].digits		= digits;
+		stmt->params[ param ].nullable		= nullable;
+	}
+
+	stmt->param_count = numparams;
+	odbc_param_cache_store( db, stmt );
+
+	return 1;
+}
+
+/*
+ * odbc_placeholders
+ *
+ * Returns 1 if the statement text contains a ? parameter marker outside of string literals,
+ * quoted identifiers and comments
+ */
+
+int odbc_placeholders( const char *query, int query_length )
+{
+	int i;
+	char quote;
+
+	for ( i = 0; i < query_length; i++ )
+	{
+		switch ( query[ i ] )
+		{
+			case '?'	: return 1;
+			case '\''	:
+			case '"'	:
+			case '['	:
+			case '`'	:
+			{
+				quote = ( query[ i ] == '[' ) ? ']' : query[ i ];
+
+				for ( i++; i < query_length && query[ i ] != quote; i++ );
+				break;
+			}
+			case '-'	:
+			{
+				if ( i + 1 < query_length && query[ i + 1 ] == '-' )
+				{
+					for ( i += 2; i < query_length && query[ i ] != '\n'; i++ );
+				}
+
+				break;
+			}
+			case '/'	:
+			{
+				if ( i + 1 < query_length && query[ i + 1 ] == '*' )
+				{
+					for ( i += 2; i + 1 < query_length && ( query[ i ] != '*' || query[ i + 1 ] != '/' ); i++ );
+					i++;
+				}
+
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * odbc_prepare
+ *
+ * Prepares a newly acquired statement.  Statements without input parameters are left unprepared
+ * when stmt_direct is set, and odbc_execute runs them with SQLExecDirect instead, saving the
+ * separate prepare round trip for statements that are not worth caching.  A statement with
+ * parameter markers but no variables is still prepared, so that odbc_describe_parameters reports
+ * the count mismatch instead of the driver failing the SQLExecDirect.
+ */
+
+int odbc_prepare( ODBCDatabase *db, ODBCStatement *stmt, mvVariableList input )
+{
+	SQLRETURN retcode;
+	LONGLONG start;
+
+	if ( stmt->prepared || ( db->stmt_direct && mvVariableList_Entries( input ) == 0 && !odbc_placeholders( stmt->query, stmt->query_length ) ) )
+	{
+		return 1;
+	}
+
+	start	= odbc_timer();
+	retcode	= SQLPrepare( stmt->hSTMT, ( SQLCHAR * ) stmt->query, stmt->query_length );
+	odbc_stats_record( db, ODBC_PHASE_PREPARE, start );
+
+	if ( retcode == SQL_ERROR )
+	{
+		return odbc_error( db, "SQLPrepare: ", stmt->hSTMT, SQL_HANDLE_STMT );
+	}
+
+	stmt->prepared = 1;
+	return 1;
+}
+
+/*
+ * odbc_execute
+ */
+
+int odbc_execute( ODBCDatabase *db, ODBCStatement *stmt, mvVariableList input )
+{
+	SQLRETURN retcode;
+	SQLPOINTER pToken;
+	SQLSMALLINT	datatype;
+	SQLUINTEGER	column_size;
+	SQLSMALLINT digits;
+	SQLSMALLINT nullable;
+	SQLHSTMT hSTMT;
+	mvVariable variable;
+	const char *value_string;
+	int value_string_length;
+	int param, numparams, offset, chunk;
+	ODBCParameter *parameter_data;
+	LONGLONG start;
+
+	hSTMT			= stmt->hSTMT;
+	numparams		= mvVariableList_Entries( input );
+
+	if ( !stmt->prepared )
+	{
+		/* Left unprepared by odbc_prepare, there is nothing to describe or bind */
+
+		start	= odbc_timer();
+		retcode	= SQLExecDirect( hSTMT, ( SQLCHAR * ) stmt->query, stmt->query_length );
+		odbc_stats_record( db, ODBC_PHASE_EXECUTE, start );
+
+		if ( retcode == SQL_ERROR )
+		{
+			odbc_error( db, "SQLExecDirect: ", hSTMT, SQL_HANDLE_STMT );
+			goto error;
+		}
+
+		db->stmt_direct_count++;
+		return 1;
+	}
+
+	parameter_data	= odbc_parameters( db, numparams );
+
+	if ( !odbc_describe_parameters( db, stmt, numparams ) )	return 0;
+	
+	for ( param = 0, variable = mvVariableList_First( input ); variable; param++, variable = mvVariableList_Next( input ) )
+	{
+		datatype	= stmt->params[ param ].datatype;
+		column_size	= stmt->params[ param ].column_size;
+		digits		= stmt->params[ param ].digits;
+		nullable	= stmt->params[ param ].nullable;
+
+		odbc_log( db, "--- Parameter %d: datatype = %d, column_size = %d, digits = %d, nullable = %d\n",
+				  param + 1,
+				  datatype,
+				  column_size,
+				  digits,
+				  nullable );
 
 		switch ( datatype )
 		{
-			case SQL_LONGVARCHAR :
-			case SQL_LONGVARBINARY :
+			case SQL_LONGVARCHAR :
+			case SQL_LONGVARBINARY :
+			{
+				value_string	= mvVariable_Value( variable, &value_string_length );
+
+				parameter_data[ param ].data_string			= value_string;
+				parameter_data[ param ].data_string_length	= value_string_length;
+				parameter_data[ param ].cbData				= SQL_LEN_DATA_AT_EXEC( 0 );
+
+				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_BINARY, datatype,
+									   0, 0, ( SQLPOINTER ) param, 0, &parameter_data[ param ].cbData ) == SQL_ERROR )
+				{
+					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
+					goto error;
+				}
+
+				break;
+			}
+			case SQL_BIGINT :
+			case SQL_TINYINT :
+			case SQL_SMALLINT :
+			case SQL_INTEGER :
+			{
+				parameter_data[ param ].data_integer	= mvVariable_Value_Integer( variable );
+				parameter_data[ param ].cbData			= sizeof( int );
+
+				odbc_log( db, "+++ Parameter %d value (integer): %d\n", param + 1, parameter_data[ param ].data_integer );
+
+				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_SLONG, datatype, 0, 0,
+									   &parameter_data[ param ].data_integer, 0,
+									   &parameter_data[ param ].cbData ) == SQL_ERROR )
+				{
+					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
+					goto error;
+				}
+
+				break;
+			}
+			case SQL_BIT :
+			{
+				parameter_data[ param ].data_integer	= mvVariable_Value_Integer( variable ) ? 1 : 0;
+				parameter_data[ param ].cbData			= sizeof( int );
+
+				odbc_log( db, "+++ Parameter %d value (integer): %d\n", param + 1, parameter_data[ param ].data_integer );
+
+				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_SLONG, datatype, 0, 0,
+									   &parameter_data[ param ].data_integer, 0,
+									   &parameter_data[ param ].cbData ) == SQL_ERROR )
+				{
+					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
+					goto error;
+				}
+
+				break;
+			}
+			case SQL_NUMERIC :
+			case SQL_DECIMAL :
+			case SQL_REAL :
+			case SQL_FLOAT :
+			case SQL_DOUBLE :
+			{
+				parameter_data[ param ].data_double		= mvVariable_Value_Double( variable );
+				parameter_data[ param ].cbData			= sizeof( double );
+
+				odbc_log( db, "+++ Parameter %d value (double): %f\n", param + 1, parameter_data[ param ].data_double );
+
+				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_DOUBLE, datatype,
+									   column_size, digits,
+									   &parameter_data[ param ].data_double, 0,
+									   &parameter_data[ param ].cbData ) == SQL_ERROR )
+				{
+					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
+					goto error;
+				}
+
+				break;
+			}
+			case SQL_CHAR :
+			case SQL_VARCHAR :
+			default :
+			{
+				value_string						= mvVariable_Value( variable, &value_string_length );
+				parameter_data[ param ].data_string	= value_string;
+				
+				if ( db->truncate && ( column_size != -1 ) && ( value_string_length > ( int ) column_size ) )
+				{
+					parameter_data[ param ].cbData		= column_size;
+				}
+				else
+				{
+					parameter_data[ param ].cbData		= value_string_length;
+				}
+
+				odbc_log( db, "+++ Parameter %d value (string): length = %d, cbData = %d, data = '%.*s'\n",
+						  param + 1, 
+						  value_string_length,
+						  parameter_data[ param ].cbData,
+						  parameter_data[ param ].cbData < 4096 ? parameter_data[ param ].cbData : 4096,
+						  parameter_data[ param ].data_string );
+
+				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_CHAR, datatype, 0, 0,
+									   ( SQLPOINTER ) parameter_data[ param ].data_string, parameter_data[ param ].cbData,
+									   &parameter_data[ param ].cbData ) == SQL_ERROR )
+				{
+					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
+					goto error;
+				}
+
+				break;
+			}
+		}	
+	}
+
+	start	= odbc_timer();
+	retcode	= SQLExecute( hSTMT );
+	odbc_stats_record( db, ODBC_PHASE_EXECUTE, start );
+
+	if ( retcode == SQL_ERROR )
+	{
+		odbc_error( db, "SQLExecute: ", hSTMT, SQL_HANDLE_STMT );
+		goto error;
+	}
+
+	while ( retcode == SQL_NEED_DATA )
+	{
+		if ( ( retcode = SQLParamData( hSTMT, &pToken ) ) == SQL_NEED_DATA )
+		{
+			param = ( int ) pToken;
+
+			odbc_log( db, "+++ Parameter %d value (string at exec): length = %d, data = '%.*s'\n",
+					  param + 1,
+					  parameter_data[ param ].data_string_length,
+					  parameter_data[ param ].data_string_length < 4096 ? parameter_data[ param ].data_string_length : 4096,
+					  parameter_data[ param ].data_string );
+			
+			/*
+			 * Stream the value straight from the Miva variable in ODBC_PUTDATA_CHUNK pieces
+			 */
+
+			offset = 0;
+
+			do
+			{
+				chunk = parameter_data[ param ].data_string_length - offset;
+				if ( chunk > ODBC_PUTDATA_CHUNK )	chunk = ODBC_PUTDATA_CHUNK;
+
+				if ( SQLPutData( hSTMT, ( SQLPOINTER ) &parameter_data[ param ].data_string[ offset ], chunk ) == SQL_ERROR )
+				{
+					/* Cancel the pending execution so that a truncated value is never executed */
+
+					odbc_error( db, "SQLPutData: ", hSTMT, SQL_HANDLE_STMT );
+					SQLCancel( hSTMT );
+					goto error;
+				}
+
+				offset += chunk;
+			} while ( offset < parameter_data[ param ].data_string_length );
+		}
+		else if ( retcode == SQL_ERROR )
+		{
+			odbc_error( db, "SQLParamData: ", hSTMT, SQL_HANDLE_STMT );
+			goto error;
+		}
+	}
+
+	return 1;
+
+error:
+	return 0;
+}
+
+/*
+ * odbc_autocommit_mode
+ *
+ * Switches the connection to SQL_AUTOCOMMIT_ON while native autocommit is active outside of a
+ * transaction, and back to SQL_AUTOCOMMIT_OFF otherwise.
+ */
+
+int odbc_autocommit_mode( ODBCDatabase *db )
+{
+	int on;
+
+	on = db->autocommit && db->autocommit_native && !db->in_transaction;
+
+	if ( on == db->autocommit_on )
+	{
+		return 1;
+	}
+
+	if ( SQLSetConnectAttr( db->hDBC, SQL_ATTR_AUTOCOMMIT, ( SQLPOINTER ) ( SQLULEN ) ( on ? SQL_AUTOCOMMIT_ON : SQL_AUTOCOMMIT_OFF ), 0 ) == SQL_ERROR )
+	{
+		return odbc_error( db, "SQLSetConnectAttr: ", db->hDBC, SQL_HANDLE_DBC );
+	}
+
+	db->autocommit_on = on;
+	return 1;
+}
+
+/*
+ * odbc_generations_committed
+ *
+ * Advances the in process and shared generations of a table whose write committed, or the flush
+ * counts if the table is not known
+ */
+
+void odbc_generations_committed( const char *table )
+{
+	odbc_generations_advance( &odbc_generations, table );
+
+	if ( odbc_shared_generations )	odbc_generations_advance( odbc_shared_generations, table );
+}
+
+/*
+ * odbc_cache_committed
+ *
+ * Advances the generations of the tables written since the previous commit once more.  Until the
+ * writes committed, other connections could still read the rows as they were before and cache
+ * them under the generations that odbc_cache_invalidate had already advanced.
+ */
+
+void odbc_cache_committed( ODBCDatabase *db )
+{
+	char name[ 129 ];
+	const char *table, *end;
+
+	if ( db->cache_written_all )
+	{
+		odbc_generations_committed( NULL );
+	}
+	else if ( db->cache_written[ 0 ] )
+	{
+		for ( table = db->cache_written + 1; *table; table = end + 1 )
+		{
+			end = strchr( table, '|' );
+
+			sprintf( name, "%.*s", ( int ) ( end - table ), table );
+			odbc_generations_committed( name );
+		}
+	}
+
+	db->cache_written[ 0 ]	= '\0';
+	db->cache_written_all	= 0;
+}
+
+/*
+ * odbc_group_commit
+ *
+ * Commits the statements held back by group commit
+ */
+
+int odbc_group_commit( ODBCDatabase *db )
+{
+	if ( db->group_pending == 0 )
+	{
+		return 1;
+	}
+
+	odbc_log( db, "--- Group commit: %d statements\n", db->group_pending );
+
+	db->group_pending = 0;
+
+	if ( SQLEndTran( SQL_HANDLE_DBC, db->hDBC, SQL_COMMIT ) == SQL_ERROR )
+	{
+		return odbc_error( db, "SQLEndTran: ", db->hDBC, SQL_HANDLE_DBC );
+	}
+
+	odbc_cache_committed( db );
+	return 1;
+}
+
+/*
+ * odbc_autocommit
+ *
+ * Called after each successful MvQUERY statement or batch.  Commits it unless a transaction is
+ * open, the driver already committed it, or group commit is holding it back.
+ */
+
+void odbc_autocommit( ODBCDatabase *db )
+{
+	ULONGLONG now;
+
+	if ( !db->autocommit || db->in_transaction )
+	{
+		return;
+	}
+
+	if ( db->autocommit_on )
+	{
+		odbc_cache_committed( db );
+		return;
+	}
+
+	if ( db->group_commit_rows <= 0 && db->group_commit_ms <= 0 )
+	{
+		if ( SQLEndTran( SQL_HANDLE_DBC, db->hDBC, SQL_COMMIT ) != SQL_ERROR )	odbc_cache_committed( db );
+		return;
+	}
+
+	now = GetTickCount64();
+
+	if ( db->group_pending++ == 0 )
+	{
+		db->group_started = now;
+	}
+
+	if ( ( db->group_commit_rows > 0 && db->group_pending >= db->group_commit_rows ) ||
+		 ( db->group_commit_ms > 0 && now - db->group_started >= ( ULONGLONG ) db->group_commit_ms ) )
+	{
+		odbc_group_commit( db );
+	}
+}
+
+/*
+ * odbc_batch_reset
+ *
+ * Releases the batched statement and discards any rows that have not been flushed
+ */
+
+void odbc_batch_reset( ODBCDatabase *db, int reusable )
+{
+	ODBCBatch *batch;
+
+	batch = db->batch;
+
+	if ( batch->stmt )		odbc_statement_release( db, batch->stmt, reusable );
+	if ( batch->values )	mvProgram_Free( NULL, batch->values );
+
+	batch->stmt				= NULL;
+	batch->values			= NULL;
+	batch->param_count		= 0;
+	batch->rows				= 0;
+	batch->strings_length	= 0;
+}
+
+/*
+ * odbc_batch_free
+ */
+
+void odbc_batch_free( ODBCDatabase *db )
+{
+	odbc_batch_reset( db, 0 );
+
+	if ( db->batch->strings )	mvProgram_Free( NULL, db->batch->strings );
+	mvProgram_Free( NULL, db->batch );
+
+	db->batch = NULL;
+}
+
+/*
+ * odbc_batch_capture
+ *
+ * Copies the values of one set of input parameters into the batch
+ */
+
+void odbc_batch_capture( ODBCBatch *batch, mvVariableList input )
+{
+	mvVariable variable;
+	ODBCBatchValue *value;
+	const char *value_string;
+	int value_string_length;
+	int strings_size;
+	char *strings;
+
+	value = &batch->values[ batch->rows * batch->param_count ];
+
+	for ( variable = mvVariableList_First( input ); variable; variable = mvVariableList_Next( input ), value++ )
+	{
+		value_string = mvVariable_Value( variable, &value_string_length );
+
+		if ( batch->strings_length + value_string_length > batch->strings_size )
+		{
+			strings_size = batch->strings_size ? batch->strings_size * 2 : 4096;
+			
+			while ( strings_size < batch->strings_length + value_string_length )
+			{
+				strings_size *= 2;
+			}
+
+			strings = ( char * ) mvProgram_Allocate( NULL, strings_size );
+
+			if ( batch->strings )
+			{
+				memcpy( strings, batch->strings, batch->strings_length );
+				mvProgram_Free( NULL, batch->strings );
+			}
+
+			batch->strings		= strings;
+			batch->strings_size	= strings_size;
+		}
+
+		memcpy( &batch->strings[ batch->strings_length ], value_string, value_string_length );
+
+		value->data_integer			= mvVariable_Value_Integer( variable );
+		value->data_double			= mvVariable_Value_Double( variable );
+		value->data_string_offset	= batch->strings_length;
+		value->data_string_length	= value_string_length;
+
+		batch->strings_length		+= value_string_length;
+	}
+
+	batch->rows++;
+}
+
+/*
+ * odbc_batch_columns
+ *
+ * Builds column-wise parameter arrays from the row-major batch values
+ */
+
+ODBCBatchColumn *odbc_batch_columns( ODBCDatabase *db, ODBCBatch *batch )
+{
+	int param, row;
+	ODBCBatchValue *value;
+	ODBCParameterInfo *info;
+	ODBCBatchColumn *columns, *column;
+
+	columns = ( ODBCBatchColumn * ) odbc_allocate( db, sizeof( ODBCBatchColumn ) * batch->param_count );
+	memset( columns, 0, sizeof( ODBCBatchColumn ) * batch->param_count );
+
+	for ( param = 0; param < batch->param_count; param++ )
+	{
+		info			= &batch->stmt->params[ param ];
+		column			= &columns[ param ];
+		column->cbData	= ( SQLLEN * ) odbc_allocate( db, sizeof( SQLLEN ) * batch->rows );
+
+		switch ( info->datatype )
+		{
+			case SQL_BIGINT :
+			case SQL_TINYINT :
+			case SQL_SMALLINT :
+			case SQL_INTEGER :
+			case SQL_BIT :
+			{
+				column->data_integer = ( int * ) odbc_allocate( db, sizeof( int ) * batch->rows );
+
+				for ( row = 0; row < batch->rows; row++ )
+				{
+					value							= &batch->values[ ( row * batch->param_count ) + param ];
+					column->data_integer[ row ]		= value->data_integer;
+					column->cbData[ row ]			= sizeof( int );
+
+					if ( info->datatype == SQL_BIT )
+					{
+						column->data_integer[ row ]	= value->data_integer ? 1 : 0;
+					}
+				}
+
+				break;
+			}
+			case SQL_NUMERIC :
+			case SQL_DECIMAL :
+			case SQL_REAL :
+			case SQL_FLOAT :
+			case SQL_DOUBLE :
+			{
+				column->data_double = ( double * ) odbc_allocate( db, sizeof( double ) * batch->rows );
+
+				for ( row = 0; row < batch->rows; row++ )
+				{
+					value							= &batch->values[ ( row * batch->param_count ) + param ];
+					column->data_double[ row ]		= value->data_double;
+					column->cbData[ row ]			= sizeof( double );
+				}
+
+				break;
+			}
+			case SQL_LONGVARCHAR :
+			case SQL_LONGVARBINARY :
+			case SQL_CHAR :
+			case SQL_VARCHAR :
+			default :
+			{
+				column->data_string_size = 1;
+
+				for ( row = 0; row < batch->rows; row++ )
+				{
+					value = &batch->values[ ( row * batch->param_count ) + param ];
+					if ( value->data_string_length > column->data_string_size )	column->data_string_size = value->data_string_length;
+				}
+
+				column->data_string = ( char * ) odbc_allocate( db, ( int ) column->data_string_size * batch->rows );
+
+				for ( row = 0; row < batch->rows; row++ )
+				{
+					value							= &batch->values[ ( row * batch->param_count ) + param ];
+					column->cbData[ row ]			= value->data_string_length;
+
+					if ( db->truncate && ( info->datatype != SQL_LONGVARCHAR ) && ( info->datatype != SQL_LONGVARBINARY ) &&
+						 ( info->column_size != ( SQLUINTEGER ) -1 ) && ( value->data_string_length > ( int ) info->column_size ) )
+					{
+						column->cbData[ row ]		= info->column_size;
+					}
+
+					memcpy( &column->data_string[ row * column->data_string_size ], &batch->strings[ value->data_string_offset ], value->data_string_length );
+				}
+
+				break;
+			}
+		}
+	}
+
+	return columns;
+}
+
+/*
+ * odbc_batch_columns_free
+ */
+
+void odbc_batch_columns_free( ODBCBatchColumn *columns, int param_count )
+{
+	int param;
+
+	for ( param = 0; param < param_count; param++ )
+	{
+		if ( columns[ param ].data_integer )	mvProgram_Free( NULL, columns[ param ].data_integer );
+		if ( columns[ param ].data_double )		mvProgram_Free( NULL, columns[ param ].data_double );
+		if ( columns[ param ].data_string )		mvProgram_Free( NULL, columns[ param ].data_string );
+		if ( columns[ param ].cbData )			mvProgram_Free( NULL, columns[ param ].cbData );
+	}
+
+	mvProgram_Free( NULL, columns );
+}
+
+/*
+ * odbc_batch_bind
+ *
+ * Binds the parameter arrays starting at the given row
+ */
+
+int odbc_batch_bind( ODBCDatabase *db, ODBCBatch *batch, ODBCBatchColumn *columns, int row )
+{
+	int param;
+	SQLRETURN retcode;
+	SQLHSTMT hSTMT;
+	ODBCParameterInfo *info;
+	ODBCBatchColumn *column;
+
+	hSTMT = batch->stmt->hSTMT;
+
+	for ( param = 0; param < batch->param_count; param++ )
+	{
+		info	= &batch->stmt->params[ param ];
+		column	= &columns[ param ];
+
+		if ( column->data_integer )
+		{
+			retcode = SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_SLONG, info->datatype, 0, 0,
+										&column->data_integer[ row ], 0, &column->cbData[ row ] );
+		}
+		else if ( column->data_double )
+		{
+			retcode = SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_DOUBLE, info->datatype, info->column_size, info->digits,
+										&column->data_double[ row ], 0, &column->cbData[ row ] );
+		}
+		else if ( info->datatype == SQL_LONGVARCHAR || info->datatype == SQL_LONGVARBINARY )
+		{
+			retcode = SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_BINARY, info->datatype, column->data_string_size, 0,
+										&column->data_string[ row * column->data_string_size ], column->data_string_size, &column->cbData[ row ] );
+		}
+		else
+		{
+			retcode = SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_CHAR, info->datatype, 0, 0,
+										&column->data_string[ row * column->data_string_size ], column->data_string_size, &column->cbData[ row ] );
+		}
+
+		if ( retcode == SQL_ERROR )
+		{
+			return odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_batch_flush
+ *
+ * Sends the batched rows as a single SQLExecute with SQL_ATTR_PARAMSET_SIZE rows.  Drivers that
+ * do not support parameter arrays are sent one SQLExecute per row.
+ */
+
+int odbc_batch_flush( ODBCDatabase *db )
+{
+	int ok, row, failed, length;
+	SQLHSTMT hSTMT;
+	SQLULEN processed;
+	SQLUSMALLINT *status;
+	ODBCBatch *batch;
+	ODBCBatchColumn *columns;
+
+	batch = db->batch;
+
+	if ( batch == NULL || batch->stmt == NULL )
+	{
+		return 1;
+	}
+
+	odbc_log( db, "*** Batch execute: rows = %d\n", batch->rows );
+
+	ok			= 1;
+	processed	= 0;
+	hSTMT		= batch->stmt->hSTMT;
+	columns		= odbc_batch_columns( db, batch );
+	status		= ( SQLUSMALLINT * ) odbc_allocate( db, sizeof( SQLUSMALLINT ) * batch->rows );
+
+	for ( row = 0; row < batch->rows; row++ )
+	{
+		status[ row ] = SQL_PARAM_UNUSED;
+	}
+
+	if ( ( SQLSetStmtAttr( hSTMT, SQL_ATTR_PARAM_BIND_TYPE,			( SQLPOINTER ) SQL_PARAM_BIND_BY_COLUMN,	0 ) != SQL_ERROR ) &&
+		 ( SQLSetStmtAttr( hSTMT, SQL_ATTR_PARAMSET_SIZE,			( SQLPOINTER ) ( SQLULEN ) batch->rows,		0 ) != SQL_ERROR ) &&
+		 ( SQLSetStmtAttr( hSTMT, SQL_ATTR_PARAM_STATUS_PTR,		status,										0 ) != SQL_ERROR ) &&
+		 ( SQLSetStmtAttr( hSTMT, SQL_ATTR_PARAMS_PROCESSED_PTR,	&processed,									0 ) != SQL_ERROR ) )
+	{
+		if ( !odbc_batch_bind( db, batch, columns, 0 ) )
+		{
+			ok = 0;
+		}
+		else if ( SQLExecute( hSTMT ) == SQL_ERROR )
+		{
+			odbc_error( db, "SQLExecute: ", hSTMT, SQL_HANDLE_STMT );
+			odbc_log( db, "*** Batch execute: %d of %d rows processed\n", ( int ) processed, batch->rows );
+
+			/*
+			 * Rows the driver did not get to were never applied, count them as failed
+			 */
+
+			for ( row = ( int ) processed; row < batch->rows; row++ )
+			{
+				if ( status[ row ] == SQL_PARAM_UNUSED )	status[ row ] = SQL_PARAM_ERROR;
+			}
+
+			ok = 0;
+		}
+
+		SQLSetStmtAttr( hSTMT, SQL_ATTR_PARAMSET_SIZE,			( SQLPOINTER ) 1,	0 );
+		SQLSetStmtAttr( hSTMT, SQL_ATTR_PARAM_STATUS_PTR,		NULL,				0 );
+		SQLSetStmtAttr( hSTMT, SQL_ATTR_PARAMS_PROCESSED_PTR,	NULL,				0 );
+	}
+	else
+	{
+		odbc_log( db, "+++ SQL_ATTR_PARAMSET_SIZE not supported, executing batch one row at a time\n" );
+
+		for ( row = 0; row < batch->rows; row++ )
+		{
+			if ( !odbc_batch_bind( db, batch, columns, row ) )
+			{
+				ok = 0;
+				break;
+			}
+
+			if ( SQLExecute( hSTMT ) == SQL_ERROR )
+			{
+				if ( ok )	odbc_error( db, "SQLExecute: ", hSTMT, SQL_HANDLE_STMT );
+
+				status[ row ]	= SQL_PARAM_ERROR;
+				ok				= 0;
+			}
+			else
+			{
+				status[ row ]	= SQL_PARAM_SUCCESS;
+			}
+
+			SQLFreeStmt( hSTMT, SQL_CLOSE );
+		}
+	}
+
+	for ( row = 0, failed = 0, length = 0; row < batch->rows; row++ )
+	{
+		if ( status[ row ] == SQL_PARAM_ERROR || ( !ok && status[ row ] == SQL_PARAM_UNUSED ) )
+		{
+			if ( failed == 0 )
+			{
+				if ( ok )	strcpy( db->error, "SQLExecute: " );
+
+				length = strlen( db->error );
+				if ( length < ( int ) sizeof( db->error ) - 64 )	length += sprintf( &db->error[ length ], " [Batch of %d rows, failed rows:", batch->rows );
+				else												length = 0;
+				
+				ok = 0;
+			}
+
+			if ( length && ( length < ( int ) sizeof( db->error ) - 16 ) )
+			{
+				length += sprintf( &db->error[ length ], " %d", row + 1 );
+			}
+
+			failed++;
+		}
+	}
+
+	if ( failed )
+	{
+		if ( length )	strcat( db->error, "]" );
+		odbc_log( db, "*** Batch execute: %d of %d rows failed\n", failed, batch->rows );
+	}
+
+	odbc_autocommit( db );
+
+	batch->last_failed = !ok && ( status[ batch->rows - 1 ] == SQL_PARAM_ERROR || status[ batch->rows - 1 ] == SQL_PARAM_UNUSED );
+
+	odbc_batch_columns_free( columns, batch->param_count );
+	mvProgram_Free( NULL, status );
+
+	odbc_batch_reset( db, ok );
+
+	return ok;
+}
+
+/*
+ * odbc_batch_queue
+ *
+ * Starts a batch for the statement if none is open and copies one set of input parameters into it
+ */
+
+int odbc_batch_queue( ODBCDatabase *db, const char *query, int query_length, mvVariableList input )
+{
+	int numparams;
+	ODBCBatch *batch;
+	ODBCStatement *stmt;
+
+	batch		= db->batch;
+	numparams	= mvVariableList_Entries( input );
+
+	if ( batch->stmt == NULL )
+	{
+		if ( ( stmt = odbc_statement_acquire( db, ODBC_STATEMENT_QUERY, query, query_length ) ) == NULL )
+		{
+			return 0;
+		}
+
+		if ( !stmt->prepared )
+		{
+			if ( SQLPrepare( stmt->hSTMT, ( char * ) query, query_length ) == SQL_ERROR )
+			{
+				odbc_error( db, "SQLPrepare: ", stmt->hSTMT, SQL_HANDLE_STMT );
+				odbc_statement_release( db, stmt, 0 );
+
+				return 0;
+			}
+
+			stmt->prepared = 1;
+		}
+
+		if ( !odbc_describe_parameters( db, stmt, numparams ) )
+		{
+			odbc_statement_release( db, stmt, 0 );
+			return 0;
+		}
+
+		batch->stmt			= stmt;
+		batch->param_count	= numparams;
+		batch->values		= ( ODBCBatchValue * ) odbc_allocate( db, sizeof( ODBCBatchValue ) * batch->size * numparams );
+	}
+	else if ( !odbc_describe_parameters( db, batch->stmt, numparams ) )
+	{
+		return 0;
+	}
+
+	odbc_batch_capture( batch, input );
+	return 1;
+}
+
+/*
+ * odbc_batch_add
+ *
+ * Queues one execution of a statement in the batch.  The batch is flushed when it fills up or
+ * when a different statement is queued.  The row is queued even if flushing the previous
+ * statement's batch failed, and the error tells the two failures apart.
+ */
+
+int odbc_batch_add( ODBCDatabase *db, const char *query, int query_length, mvVariableList input )
+{
+	int ok;
+	ODBCBatch *batch;
+	char earlier[ sizeof( db->error ) ];
+
+	ok		= 1;
+	batch	= db->batch;
+
+	if ( batch->stmt && ( ( batch->stmt->query_length != query_length ) || memcmp( batch->stmt->query, query, query_length ) ) )
+	{
+		if ( !odbc_batch_flush( db ) )
+		{
+			strcpy( earlier, db->error );
+			ok = 0;
+		}
+	}
+
+	if ( !odbc_batch_queue( db, query, query_length, input ) )
+	{
+		if ( !ok && strlen( db->error ) < sizeof( db->error ) - 450 )
+		{
+			sprintf( &db->error[ strlen( db->error ) ], " (the previous batch also failed: %.400s)", earlier );
+		}
+		return 0;
+	}
+
+	if ( !ok )
+	{
+		sprintf( db->error, "Statement queued, but the previous batch failed: %.900s", earlier );
+		return 0;
+	}
+
+	if ( batch->rows >= batch->size && !odbc_batch_flush( db ) )
+	{
+		if ( !batch->last_failed )
+		{
+			strcpy( earlier, db->error );
+			sprintf( db->error, "Statement executed, but earlier rows of its batch failed: %.900s", earlier );
+		}
+
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_bind_buffers
+ *
+ * Binds the column-wise rowset buffers of each bound column
+ */
+
+int odbc_bind_buffers( ODBCDatabaseView *odbcview )
+{
+	int i;
+	SQLRETURN retcode;
+	ODBCDatabaseVariable *odbcvar;
+
+	for ( i = 0; i < odbcview->column_count; i++ )
+	{
+		odbcvar = odbcview->columns[ i ];
+
+		switch ( odbcvar->type )
+		{
+			case ODBC_INTEGER	: retcode = SQLBindCol( odbcview->hSTMT, odbcvar->column, SQL_C_SLONG,	odbcvar->rows_integer,	sizeof( int ),				odbcvar->rows_cbData );	break;
+			case ODBC_DOUBLE	: retcode = SQLBindCol( odbcview->hSTMT, odbcvar->column, SQL_C_DOUBLE,	odbcvar->rows_double,	sizeof( double ),			odbcvar->rows_cbData );	break;
+			case ODBC_STRING	: retcode = SQLBindCol( odbcview->hSTMT, odbcvar->column, SQL_C_CHAR,	odbcvar->rows_string,	odbcvar->data_string_size,	odbcvar->rows_cbData );	break;
+			case ODBC_BLOB		:
+			{
+				if ( odbcvar->rows_string == NULL )	continue;
+
+				retcode = SQLBindCol( odbcview->hSTMT, odbcvar->column, SQL_C_CHAR, odbcvar->rows_string, odbcvar->data_string_size, odbcvar->rows_cbData );
+				break;
+			}
+			default				: continue;
+		}
+
+		if ( retcode != SQL_SUCCESS )
+		{
+			return odbc_error( odbcview->db, "SQLBindCol: ", odbcview->hSTMT, SQL_HANDLE_STMT );
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_bind_rowset
+ *
+ * Switches the statement to column-wise block fetching of view->rowset_size rows
+ */
+
+int odbc_bind_rowset( ODBCDatabaseView *odbcview )
+{
+	if ( ( SQLSetStmtAttr( odbcview->hSTMT, SQL_ATTR_ROW_BIND_TYPE,		( SQLPOINTER ) SQL_BIND_BY_COLUMN,				0 ) == SQL_ERROR ) ||
+		 ( SQLSetStmtAttr( odbcview->hSTMT, SQL_ATTR_ROW_ARRAY_SIZE,	( SQLPOINTER ) ( SQLULEN ) odbcview->rowset_size,	0 ) == SQL_ERROR ) )
+	{
+		odbc_log( odbcview->db, "+++ SQLSetStmtAttr( SQL_ATTR_ROW_ARRAY_SIZE, %d ) failed, defaulting to single row fetch\n", odbcview->rowset_size );
+		odbcview->rowset_size = 1;
+
+		return 1;
+	}
+
+	if ( SQLSetStmtAttr( odbcview->hSTMT, SQL_ATTR_ROW_STATUS_PTR,		odbcview->rowset_status,						0 ) == SQL_ERROR )	return odbc_error( odbcview->db, "SQLSetStmtAttr: ", odbcview->hSTMT, SQL_HANDLE_STMT );
+	if ( SQLSetStmtAttr( odbcview->hSTMT, SQL_ATTR_ROWS_FETCHED_PTR,	&odbcview->rowset_count,						0 ) == SQL_ERROR )	return odbc_error( odbcview->db, "SQLSetStmtAttr: ", odbcview->hSTMT, SQL_HANDLE_STMT );
+
+	return 1;
+}
+
+/*
+ * odbc_describe_columns
+ *
+ * Describes each result column and chooses how it will be bound
+ */
+
+int odbc_describe_columns( ODBCDatabaseView *odbcview, ODBCColumnInfo *columns, int nCols )
+{
+	SWORD i;
+	ODBCColumnInfo *info;
+
+	for ( i = 1; i <= nCols; i++ )
+	{
+		info				= &columns[ i - 1 ];
+		info->observed_size	= -1;
+
+		if ( SQLDescribeCol( odbcview->hSTMT, i, info->name, sizeof( info->name ), &info->name_length,
+							 &info->sql_type, &info->precision, &info->scale, &info->nullable ) != SQL_SUCCESS )	return odbc_error( odbcview->db, "SQLDescribeCol: ", odbcview->hSTMT, SQL_HANDLE_STMT );
+
+		odbc_log( odbcview->db, "--- Result %d: name = '%.*s', sqltype = %d, precision = %d, scale = %d, nullable = %d\n",
+				  i,
+				  info->name_length > 100 ? 100 : info->name_length, info->name,
+				  info->sql_type,
+				  info->precision,
+				  info->scale,
+				  info->nullable );
+
+		switch ( info->sql_type )
+		{
+			case SQL_BIGINT :
+			case SQL_TINYINT :
+			case SQL_SMALLINT :
+			case SQL_INTEGER :
+			case SQL_BIT :
+			{
+				info->type	= ODBC_INTEGER;
+				break;
+			}
+			case SQL_NUMERIC :
+			case SQL_DECIMAL :
+			case SQL_REAL :
+			case SQL_FLOAT :
+			case SQL_DOUBLE :
+			{
+				info->type	= ODBC_DOUBLE;
+				break;
+			}
+			case SQL_LONGVARBINARY :
+			case SQL_LONGVARCHAR :
+			{
+				info->type	= ODBC_BLOB;
+				break;
+			}
+			case SQL_CHAR :
+			default :
+			{
+				info->type	= ODBC_STRING;
+
+				if ( !info->precision && !info->scale )		info->data_string_size	= 50;
+				else if ( info->precision > 0x3FFFFFFF )	info->data_string_size	= 0x3FFFFFFF;
+				else										info->data_string_size	= info->precision + info->scale + 1;
+				
+				break;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_shape_release
+ */
+
+void odbc_shape_release( ODBCResultShape *shape )
+{
+	if ( --shape->references == 0 )
+	{
+		mvProgram_Free( NULL, shape->columns );
+		mvProgram_Free( NULL, shape->query );
+		mvProgram_Free( NULL, shape );
+	}
+}
+
+/*
+ * odbc_shape_cache_trim
+ */
+
+void odbc_shape_cache_trim( ODBCDatabase *db, int limit )
+{
+	int count;
+	ODBCResultShape *shape, **link;
+
+	for ( count = 0, link = &db->shape_cache; ( shape = *link ) != NULL; )
+	{
+		if ( count < limit )
+		{
+			link = &shape->next;
+			count++;
+
+			continue;
+		}
+
+		*link		= shape->next;
+		shape->next	= NULL;
+
+		odbc_shape_release( shape );
+		db->shape_cache_count--;
+	}
+}
+
+/*
+ * odbc_shape_matches
+ *
+ * Verifies a cached shape against the column count and types of the executed statement
+ */
+
+int odbc_shape_matches( ODBCDatabaseView *odbcview, ODBCResultShape *shape, SWORD nCols )
+{
+	SWORD i;
+	SQLLEN sql_type;
+
+	if ( shape->column_count != nCols )
+	{
+		return 0;
+	}
+
+	for ( i = 1; i <= nCols; i++ )
+	{
+		sql_type = 0;
+
+		if ( ( SQLColAttribute( odbcview->hSTMT, i, SQL_DESC_CONCISE_TYPE, NULL, 0, NULL, &sql_type ) != SQL_SUCCESS ) ||
+			 ( sql_type != shape->columns[ i - 1 ].sql_type ) )
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_shape_lookup
+ *
+ * Returns a reference to the cached result shape of a query without an executed statement to
+ * validate it against, or NULL if the query has not been seen.
+ */
+
+ODBCResultShape *odbc_shape_lookup( ODBCDatabase *db, const char *query, int query_length )
+{
+	unsigned int hash;
+	ODBCResultShape *shape, **link;
+
+	hash = odbc_statement_hash( query, query_length );
+
+	for ( link = &db->shape_cache; ( shape = *link ) != NULL; link = &shape->next )
+	{
+		if ( shape->hash == hash && shape->query_length == query_length && !memcmp( shape->query, query, query_length ) )
+		{
+			*link				= shape->next;
+			shape->next			= db->shape_cache;
+			db->shape_cache		= shape;
+			db->shape_cache_hits++;
+
+			shape->references++;
+			return shape;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * odbc_shape_create
+ *
+ * Describes the view's result columns into a new, uncached result shape
+ */
+
+ODBCResultShape *odbc_shape_create( ODBCDatabaseView *odbcview, unsigned int hash, const char *query, int query_length, SWORD nCols )
+{
+	ODBCDatabase *db;
+	ODBCResultShape *shape;
+
+	db						= odbcview->db;
+	shape					= ( ODBCResultShape * ) odbc_allocate( db, sizeof( ODBCResultShape ) );
+	memset( shape, 0, sizeof( ODBCResultShape ) );
+
+	shape->references		= 1;
+	shape->hash				= hash;
+	shape->query_length		= query_length;
+	shape->query			= ( char * ) odbc_allocate( db, query_length + 1 );
+	shape->column_count		= nCols;
+	shape->columns			= ( ODBCColumnInfo * ) odbc_allocate( db, sizeof( ODBCColumnInfo ) * ( nCols + 1 ) );
+
+	memcpy( shape->query, query, query_length );
+	shape->query[ query_length ] = '\0';
+
+	if ( !odbc_describe_columns( odbcview, shape->columns, nCols ) )
+	{
+		odbc_shape_release( shape );
+		return NULL;
+	}
+
+	return shape;
+}
+
+/*
+ * odbc_shape_acquire
+ *
+ * Returns the result shape of the view's statement, from the metadata cache if the cached entry
+ * still matches the executed statement, otherwise by describing the columns.
+ */
+
+ODBCResultShape *odbc_shape_acquire( ODBCDatabaseView *odbcview )
+{
+	SWORD nCols;
+	ODBCDatabase *db;
+	ODBCStatement *stmt;
+	ODBCResultShape *shape, **link;
+
+	db		= odbcview->db;
+	stmt	= odbcview->stmt;
+
+	if ( SQLNumResultCols( odbcview->hSTMT, &nCols ) != SQL_SUCCESS )
+	{
+		odbc_error( db, "SQLNumResultCols: ", odbcview->hSTMT, SQL_HANDLE_STMT );
+		return NULL;
+	}
+
+	for ( link = &db->shape_cache; ( shape = *link ) != NULL; link = &shape->next )
+	{
+		if ( shape->hash == stmt->hash && shape->query_length == stmt->query_length && !memcmp( shape->query, stmt->query, stmt->query_length ) )
+		{
+			*link = shape->next;
+
+			if ( !odbc_shape_matches( odbcview, shape, nCols ) )
+			{
+				odbc_log( db, "+++ Result shape changed, describing columns again\n" );
+
+				shape->next = NULL;
+				odbc_shape_release( shape );
+				db->shape_cache_count--;
+
+				break;
+			}
+
+			shape->next			= db->shape_cache;
+			db->shape_cache		= shape;
+			db->shape_cache_hits++;
+
+			shape->references++;
+			return shape;
+		}
+	}
+
+	if ( db->shape_cache_size )
+	{
+		db->shape_cache_misses++;
+	}
+
+	if ( ( shape = odbc_shape_create( odbcview, stmt->hash, stmt->query, stmt->query_length, nCols ) ) == NULL )
+	{
+		return NULL;
+	}
+
+	if ( db->shape_cache_size )
+	{
+		shape->references++;
+		shape->next			= db->shape_cache;
+		db->shape_cache		= shape;
+		db->shape_cache_count++;
+
+		odbc_shape_cache_trim( db, db->shape_cache_size );
+	}
+
+	return shape;
+}
+
+/*
+ * odbc_getdata_extensions
+ */
+
+SQLUINTEGER odbc_getdata_extensions( ODBCDatabase *db )
+{
+	if ( !db->getdata_known )
+	{
+		db->getdata_known		= 1;
+		db->getdata_extensions	= 0;
+
+		if ( SQLGetInfo( db->hDBC, SQL_GETDATA_EXTENSIONS, &db->getdata_extensions, sizeof( db->getdata_extensions ), NULL ) == SQL_ERROR )
+		{
+			db->getdata_extensions = 0;
+		}
+
+		odbc_log( db, "--- SQL_GETDATA_EXTENSIONS = 0x%x\n", ( unsigned int ) db->getdata_extensions );
+	}
+
+	return db->getdata_extensions;
+}
+
+/*
+ * odbc_single_activity
+ *
+ * Returns 1 if the primary connection, or the replica's if one is given, cannot run another
+ * statement while a result is being read, as with SQL Server without MARS
+ */
+
+int odbc_single_activity( ODBCDatabase *db, ODBCReplica *replica )
+{
+	int *known;
+	SQLHDBC hDBC;
+	SQLUSMALLINT *max_activities;
+
+	if ( replica )
+	{
+		known			= &replica->activities_known;
+		max_activities	= &replica->max_activities;
+		hDBC			= replica->connection->hDBC;
+	}
+	else
+	{
+		known			= &db->activities_known;
+		max_activities	= &db->max_activities;
+		hDBC			= db->hDBC;
+	}
+
+	if ( !*known )
+	{
+		*known			= 1;
+		*max_activities	= 0;
+
+		if ( SQLGetInfo( hDBC, SQL_MAX_CONCURRENT_ACTIVITIES, max_activities, sizeof( SQLUSMALLINT ), NULL ) == SQL_ERROR )
+		{
+			*max_activities = 0;
+		}
+
+		odbc_log( db, "--- SQL_MAX_CONCURRENT_ACTIVITIES = %d%s%s\n", ( int ) *max_activities, replica ? ", read replica " : "", replica ? replica->key : "" );
+	}
+
+	return *max_activities == 1;
+}
+
+/*
+ * odbc_string_size
+ *
+ * Returns the bound buffer size of a string column.  When overflowing values can be read with
+ * SQLGetData the buffer is capped, and sized from the observed widths if any are known.
+ */
+
+SDWORD odbc_string_size( ODBCDatabase *db, ODBCColumnInfo *info, int overflow )
+{
+	SDWORD size;
+
+	size = info->data_string_size;
+
+	if ( !overflow )
+	{
+		return size;
+	}
+
+	if ( db->string_learn && info->observed_size >= 0 )
+	{
+		size = info->observed_size + info->observed_size / 4 + 1;
+
+		if ( size < 32 )						size = 32;
+		if ( size > info->data_string_size )	size = info->data_string_size;
+	}
+
+	if ( db->string_max > 0 && size > db->string_max )
+	{
+		size = db->string_max;
+	}
+
+	return size;
+}
+
+/*
+ * odbc_prefetch_fetch
+ *
+ * Fetches the next rowset into one of the two sets of rowset buffers
+ */
+
+SQLRETURN odbc_prefetch_fetch( ODBCDatabaseView *view, int slot )
+{
+	view->bind_offset					= slot ? view->buffer_span : 0;
+	view->prefetch_fetched[ slot ]		= 0;
+
+	if ( ( SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROW_STATUS_PTR,	( char * ) view->rowset_status + view->bind_offset,	0 ) == SQL_ERROR ) ||
+		 ( SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROWS_FETCHED_PTR,	&view->prefetch_fetched[ slot ],					0 ) == SQL_ERROR ) )
+	{
+		return SQL_ERROR;
+	}
+
+	return SQLFetchScroll( view->hSTMT, SQL_FETCH_NEXT, 0 );
+}
+
+/*
+ * odbc_prefetch_thread
+ */
+
+DWORD WINAPI odbc_prefetch_thread( LPVOID context )
+{
+	ODBCDatabaseView *view;
+
+	view = ( ODBCDatabaseView * ) context;
+
+	for ( ;; )
+	{
+		WaitForSingleObject( view->prefetch_request, INFINITE );
+
+		if ( view->prefetch_stop )
+		{
+			break;
+		}
+
+		view->prefetch_retcode = odbc_prefetch_fetch( view, view->prefetch_slot );
+		SetEvent( view->prefetch_done );
+	}
+
+	return 0;
+}
+
+/*
+ * odbc_prefetch_start
+ *
+ * Starts the prefetch thread of a view.  Failing to do so is not an error, the view then fetches
+ * each rowset when it is needed.
+ */
+
+void odbc_prefetch_start( ODBCDatabaseView *view )
+{
+	if ( SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROW_BIND_OFFSET_PTR, &view->bind_offset, 0 ) == SQL_ERROR )
+	{
+		odbc_log( view->db, "+++ SQL_ATTR_ROW_BIND_OFFSET_PTR not supported, prefetch disabled\n" );
+		return;
+	}
+
+	view->prefetch_request	= CreateEvent( NULL, FALSE, FALSE, NULL );
+	view->prefetch_done		= CreateEvent( NULL, FALSE, FALSE, NULL );
+
+	if ( view->prefetch_request && view->prefetch_done )
+	{
+		view->prefetch_thread = CreateThread( NULL, 0, odbc_prefetch_thread, view, 0, NULL );
+	}
+
+	if ( view->prefetch_thread == NULL )
+	{
+		odbc_log( view->db, "+++ Unable to start the prefetch thread (%u)\n", ( unsigned int ) GetLastError() );
+
+		if ( view->prefetch_request )	CloseHandle( view->prefetch_request );
+		if ( view->prefetch_done )		CloseHandle( view->prefetch_done );
+
+		view->prefetch_request	= NULL;
+		view->prefetch_done		= NULL;
+
+		SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROW_BIND_OFFSET_PTR, NULL, 0 );
+	}
+}
+
+/*
+ * odbc_prefetch_stop
+ */
+
+void odbc_prefetch_stop( ODBCDatabaseView *view )
+{
+	if ( view->prefetch_thread == NULL )
+	{
+		return;
+	}
+
+	if ( view->prefetch_pending )
+	{
+		WaitForSingleObject( view->prefetch_done, INFINITE );
+		view->prefetch_pending = 0;
+	}
+
+	view->prefetch_stop = 1;
+	SetEvent( view->prefetch_request );
+	WaitForSingleObject( view->prefetch_thread, INFINITE );
+
+	CloseHandle( view->prefetch_thread );
+	CloseHandle( view->prefetch_request );
+	CloseHandle( view->prefetch_done );
+
+	view->prefetch_thread = NULL;
+
+	SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROW_BIND_OFFSET_PTR, NULL, 0 );
+}
+
+/*
+ * odbc_fetch_next
+ *
+ * Fetches the next rowset of a forward-only block cursor.  With prefetch, the rowset was usually
+ * fetched into the other set of buffers while the script read the current one, so only the buffers
+ * are swapped, and the following rowset is requested straight away.
+ */
+
+SQLRETURN odbc_fetch_next( ODBCDatabaseView *view )
+{
+	int slot;
+	SQLRETURN retcode;
+
+	view->rowset_count = 0;
+
+	if ( view->prefetch_thread == NULL )
+	{
+		return SQLFetchScroll( view->hSTMT, SQL_FETCH_NEXT, 0 );
+	}
+
+	if ( view->prefetch_pending )
+	{
+		WaitForSingleObject( view->prefetch_done, INFINITE );
+
+		view->prefetch_pending	= 0;
+		slot					= view->prefetch_slot;
+		retcode					= view->prefetch_retcode;
+	}
+	else
+	{
+		slot					= view->buffer_offset ? 0 : 1;
+		retcode					= odbc_prefetch_fetch( view, slot );
+	}
+
+	view->buffer_offset	= slot ? view->buffer_span : 0;
+	view->rowset_count	= view->prefetch_fetched[ slot ];
+
+	if ( ( retcode == SQL_SUCCESS || retcode == SQL_SUCCESS_WITH_INFO ) && ( view->rowset_count == ( SQLULEN ) view->rowset_size ) )
+	{
+		view->prefetch_slot		= !slot;
+		view->prefetch_pending	= 1;
+
+		SetEvent( view->prefetch_request );
+	}
+
+	return retcode;
+}
+
+/*
+ * odbc_bind_columns
+ *
+ * The row layout is computed once from the result shape, and every variable and bind buffer of the
+ * view is carved out of a single arena.  The buffers are bound to the statement by odbc_view_start.
+ */
+
+int odbc_bind_columns( mvDatabaseView view, ODBCDatabaseView *odbcview )
+{
+	SWORD i, nCols;
+	int size, has_blob, inline_blob, overflow, prefetch;
+	ULONGLONG layout;
+	SQLUINTEGER extensions;
+	ODBCArena *arena;
+	ODBCColumnInfo *columns, *info;
+	ODBCDatabaseVariable *odbcvar;
+
+	if ( ( odbcview->shape == NULL ) && ( ( odbcview->shape = odbc_shape_acquire( odbcview ) ) == NULL ) )
+	{
+		return 0;
+	}
+
+	nCols	= odbcview->shape->column_count;
+	columns	= odbcview->shape->columns;
+
+	for ( i = 0, has_blob = 0; i < nCols; i++ )
+	{
+		if ( columns[ i ].type == ODBC_BLOB )	has_blob = 1;
+	}
+
+	/*
+	 * TEXT/BLOB columns are bound inline when the driver allows SQLGetData on bound columns, which
+	 * is only needed for values that overflow the inline buffer.  Unbound columns and overflow reads
+	 * within a rowset require SQL_GD_BLOCK, otherwise block fetching is disabled.
+	 */
+
+	inline_blob	= 0;
+	extensions	= odbc_getdata_extensions( odbcview->db );
+
+	if ( has_blob )
+	{
+		if ( odbcview->db->inline_blob > 0 && ( extensions & SQL_GD_BOUND ) )
+		{
+			inline_blob = odbcview->db->inline_blob + 1;
+		}
+
+		if ( odbcview->rowset_size > 1 && !( extensions & SQL_GD_BLOCK ) )
+		{
+			odbc_log( odbcview->db, "+++ Result contains BLOB columns, defaulting to single row fetch\n" );
+			odbcview->rowset_size = 1;
+		}
+	}
+
+	if ( odbcview->rowset_size < 1 )
+	{
+		odbcview->rowset_size = 1;
+	}
+
+reduced:
+
+	/*
+	 * String buffers are only capped when the overflow can be read back with SQLGetData
+	 */
+
+	overflow = ( extensions & SQL_GD_BOUND ) && ( odbcview->rowset_size == 1 || ( extensions & SQL_GD_BLOCK ) );
+
+	/*
+	 * Prefetch moves the cursor past the rowset being read, so it is only used when every value can
+	 * be read from the bound buffers.  The arena then holds a second set of rowset buffers at a fixed
+	 * offset, selected with SQL_ATTR_ROW_BIND_OFFSET_PTR.
+	 */
+
+	prefetch = odbcview->db->prefetch && odbcview->forwardonly && ( odbcview->rowset_size > 1 ) && !has_blob;
+
+	for ( i = 0; prefetch && i < nCols; i++ )
+	{
+		if ( columns[ i ].type == ODBC_STRING && odbcview->db->string_max > 0 && columns[ i ].data_string_size > odbcview->db->string_max )
+		{
+			odbc_log( odbcview->db, "+++ Column %d may exceed stringmax, prefetch disabled\n", i + 1 );
+			prefetch = 0;
+		}
+	}
+
+	if ( prefetch )
+	{
+		overflow = 0;
+	}
+
+	/*
+	 * Compute the layout, in 64 bits since wide string columns times a large rowset can overflow
+	 */
+
+	layout =	ODBC_ARENA_ALIGN( sizeof( ODBCDatabaseVariable ) ) * ( nCols + 3 ) +
+				ODBC_ARENA_ALIGN( sizeof( ODBCDatabaseVariable * ) * ( nCols + 1 ) ) +
+				ODBC_ARENA_ALIGN( sizeof( SQLUSMALLINT ) * ( ULONGLONG ) odbcview->rowset_size );
+
+	for ( i = 0; i < nCols; i++ )
+	{
+		switch ( columns[ i ].type )
+		{
+			case ODBC_INTEGER	: layout += ODBC_ARENA_ALIGN( sizeof( int ) * ( ULONGLONG ) odbcview->rowset_size );		break;
+			case ODBC_DOUBLE	: layout += ODBC_ARENA_ALIGN( sizeof( double ) * ( ULONGLONG ) odbcview->rowset_size );		break;
+			case ODBC_STRING	: layout += ODBC_ARENA_ALIGN( ( ULONGLONG ) odbc_string_size( odbcview->db, &columns[ i ], overflow ) * odbcview->rowset_size + 1 );	break;
+			case ODBC_BLOB		:
+			{
+				if ( !inline_blob )	continue;
+
+				layout += ODBC_ARENA_ALIGN( ( ULONGLONG ) inline_blob * odbcview->rowset_size + 1 );
+				break;
+			}
+		}
+
+		layout += ODBC_ARENA_ALIGN( sizeof( SQLLEN ) * ( ULONGLONG ) odbcview->rowset_size );
+	}
+
+	if ( layout > ODBC_ARENA_ROWSET_MAX && odbcview->rowset_size > 1 )
+	{
+		odbc_log( odbcview->db, "+++ Rowset buffers would take %I64u bytes, defaulting to single row fetch\n", layout );
+		odbcview->rowset_size = 1;
+
+		goto reduced;
+	}
+
+	if ( layout > ODBC_ARENA_MAX )
+	{
+		sprintf( odbcview->db->error, "The row buffers of the view would take %I64u bytes, more than the %d bytes allowed", layout, ODBC_ARENA_MAX );
+		return 0;
+	}
+
+	size = ( int ) layout;
+
+	arena					= odbc_arena_create( odbcview->db, prefetch ? size * 2 : size, nCols + 3 + 1 );
+	odbcview->arena			= arena;
+	odbcview->buffer_span	= prefetch ? size : 0;
+
+	/*
+	 * Allocating each variable and buffer separately takes the recno, eof and deleted variables, the
+	 * column array and the rowset status, then each column's variable and, if it is bound, its
+	 * indicators and its rowset buffer
+	 */
+
+	odbcview->db->view_allocations++;
+	odbcview->db->view_variable_allocations += 5;
+
+	odbc_log( odbcview->db, "--- View layout: columns = %d, rowset = %d, inline blob = %d, prefetch = %d, arena = %d bytes\n", nCols, odbcview->rowset_size, inline_blob, prefetch, size );
+
+	/*
+	 * Setup "special" variables (recno, eof, deleted)
+	 */
+
+	odbcview->recno			= odbc_arena_carve( arena, sizeof( ODBCDatabaseVariable ) ); memset( odbcview->recno,	0, sizeof( ODBCDatabaseVariable ) );
+	odbcview->eof			= odbc_arena_carve( arena, sizeof( ODBCDatabaseVariable ) ); memset( odbcview->eof,		0, sizeof( ODBCDatabaseVariable ) );
+	odbcview->deleted		= odbc_arena_carve( arena, sizeof( ODBCDatabaseVariable ) ); memset( odbcview->deleted,	0, sizeof( ODBCDatabaseVariable ) );
+
+	odbcview->recno->arena		= arena;
+	odbcview->eof->arena		= arena;
+	odbcview->deleted->arena	= arena;
+	
+	mvDatabaseView_AddVariable( view, "recno",		5, odbcview->recno );		odbcview->recno->type	= ODBC_INTEGER;
+	mvDatabaseView_AddVariable( view, "eof",		3, odbcview->eof );			odbcview->eof->type		= ODBC_INTEGER;
+	mvDatabaseView_AddVariable( view, "deleted",	7, odbcview->deleted );		odbcview->deleted->type	= ODBC_INTEGER;
+
+	odbcview->columns		= ( ODBCDatabaseVariable ** ) odbc_arena_carve( arena, sizeof( ODBCDatabaseVariable * ) * ( nCols + 1 ) );
+	odbcview->rowset_status	= ( SQLUSMALLINT * ) odbc_arena_carve( arena, sizeof( SQLUSMALLINT ) * odbcview->rowset_size );
+
+	memset( odbcview->rowset_status, 0, sizeof( SQLUSMALLINT ) * odbcview->rowset_size );
+
+	/*
+	 * Carve the remainder of the results
+	 */
+
+	for ( i = 1; i <= nCols; i++ )
+	{
+		info						= &columns[ i - 1 ];
+		odbcvar						= ( ODBCDatabaseVariable * ) odbc_arena_carve( arena, sizeof( ODBCDatabaseVariable ) );
+		memset( odbcvar, 0, sizeof( ODBCDatabaseVariable ) );
+
+		odbcvar->arena				= arena;
+		odbcvar->column				= i;
+		odbcvar->type				= info->type;
+		odbcvar->data_string_size	= info->data_string_size;
+		odbcvar->observed_size		= -1;
+
+		switch ( odbcvar->type )
+		{
+			case ODBC_INTEGER	: odbcvar->rows_integer	= ( int * ) odbc_arena_carve( arena, sizeof( int ) * odbcview->rowset_size );			break;
+			case ODBC_DOUBLE	: odbcvar->rows_double	= ( double * ) odbc_arena_carve( arena, sizeof( double ) * odbcview->rowset_size );		break;
+			case ODBC_STRING	:
+			{
+				odbcvar->data_string_size	= odbc_string_size( odbcview->db, info, overflow );
+				odbcvar->rows_string		= ( char * ) odbc_arena_carve( arena, odbcvar->data_string_size * odbcview->rowset_size + 1 );
+				odbcvar->data_string		= odbcvar->rows_string;
+
+				if ( overflow )
+				{
+					odbcvar->overflow		= 1;
+					odbcvar->data_blob_stmt	= odbcview->hSTMT;
+					odbcvar->data_blob_col	= i;
+					odbcvar->data_blob_max	= ( odbcview->db->blob_max > 0 ) ? odbcview->db->blob_max : 0x3FFFFFFF;
+				}
+
+				break;
+			}
+			case ODBC_BLOB		:
+			{
+				odbcvar->data_blob_stmt	= odbcview->hSTMT;
+				odbcvar->data_blob_col	= i;
+				odbcvar->data_blob_max	= ( odbcview->db->blob_max > 0 ) ? odbcview->db->blob_max : 0x3FFFFFFF;
+
+				if ( inline_blob )
+				{
+					odbcvar->data_string_size	= inline_blob;
+					odbcvar->rows_string		= ( char * ) odbc_arena_carve( arena, inline_blob * odbcview->rowset_size + 1 );
+					odbcvar->data_string		= odbcvar->rows_string;
+				}
+
+				break;
+			}
+		}
+
+		if ( odbcvar->type != ODBC_BLOB || odbcvar->rows_string )
+		{
+			odbcvar->rows_cbData	= ( SQLLEN * ) odbc_arena_carve( arena, sizeof( SQLLEN ) * odbcview->rowset_size );
+			memset( odbcvar->rows_cbData, 0, sizeof( SQLLEN ) * odbcview->rowset_size );
+
+			odbcview->db->view_variable_allocations += 2;
+		}
+
+		odbcview->db->view_variable_allocations++;
+
+		odbcview->columns[ odbcview->column_count++ ] = odbcvar;
+		mvDatabaseView_AddVariable( view, info->name, info->name_length, odbcvar );
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_blob_grow
+ */
+
+void odbc_blob_grow( ODBCDatabaseVariable *var, int size )
+{
+	char *buffer;
+
+	if ( size <= var->blob_size )
+	{
+		return;
+	}
+
+	buffer = ( char * ) mvProgram_Allocate( NULL, size + 1 ); /* The extra byte is required because an Oracle developer can't count */
+
+	if ( var->blob )
+	{
+		memcpy( buffer, var->blob, var->blob_length );
+		mvProgram_Free( NULL, var->blob );
+	}
+
+	var->blob		= buffer;
+	var->blob_size	= size;
+}
+
+/*
+ * odbc_blob_read
+ *
+ * Streams the current row's value of a TEXT/BLOB column with SQLGetData into the variable's buffer,
+ * growing it to the reported length or geometrically when the driver returns SQL_NO_TOTAL.  The
+ * assembled value is kept until the next row is selected, since most drivers only allow one read.
+ */
+
+int odbc_blob_read( ODBCDatabase *db, ODBCDatabaseVariable *var )
+{
+	int available, chunks;
+	SQLLEN blob_len;
+	SQLRETURN result;
+	LONGLONG start;
+
+	var->blob_cached	= 1;
+	var->blob_length	= 0;
+	var->blob_null		= 0;
+
+	if ( var->data_blob_row < 0 )
+	{
+		sprintf( db->error, "The value of column %d was not read while the cursor was on its row and is no longer available", var->column );
+		odbc_log( db, "+++ %s\n", db->error );
+
+		return 0;
+	}
+
+	if ( var->data_blob_row && SQLSetPos( var->data_blob_stmt, ( SQLUSMALLINT ) var->data_blob_row, SQL_POSITION, SQL_LOCK_NO_CHANGE ) == SQL_ERROR )
+	{
+		return odbc_error( db, "SQLSetPos: ", var->data_blob_stmt, SQL_HANDLE_STMT );
+	}
+
+	if ( var->rows_string && var->cbData > 0 )	odbc_blob_grow( var, var->cbData + 1 );
+	else										odbc_blob_grow( var, 4096 );
+
+	start = odbc_timer();
+
+	for ( chunks = 1; ; chunks++ )
+	{
+		available	= var->blob_size - var->blob_length;
+		blob_len	= 0;
+		result		= SQLGetData( var->data_blob_stmt, var->data_blob_col, SQL_C_CHAR, &var->blob[ var->blob_length ], available, &blob_len );
+
+		if ( result == SQL_ERROR )
+		{
+			var->blob_length = 0;
+			return odbc_error( db, "SQLGetData: ", var->data_blob_stmt, SQL_HANDLE_STMT );
+		}
+		else if ( result == SQL_NO_DATA )
+		{
+			break;
+		}
+		else if ( blob_len == SQL_NULL_DATA )
+		{
+			var->blob_null = 1;
+			break;
+		}
+		else if ( blob_len != SQL_NO_TOTAL && blob_len < available )
+		{
+			var->blob_length += ( int ) blob_len;
+			break;
+		}
+
+		/*
+		 * Truncated: the chunk is full less its null terminator
+		 */
+
+		var->blob_length += available - 1;
+
+		if ( var->blob_length >= var->data_blob_max )
+		{
+			odbc_log( db, "+++ BLOB data for column %d truncated at %d bytes\n", var->column, var->blob_length );
+			break;
+		}
+
+		if ( blob_len == SQL_NO_TOTAL )	odbc_blob_grow( var, var->blob_size * 2 );
+		else							odbc_blob_grow( var, var->blob_length + ( int ) ( blob_len - ( available - 1 ) ) + 1 );
+
+		if ( var->blob_size > var->data_blob_max + 1 )
+		{
+			odbc_blob_grow( var, var->data_blob_max + 1 );
+		}
+	}
+
+	if ( var->blob_length > var->data_blob_max )
+	{
+		var->blob_length = var->data_blob_max;
+	}
+
+	var->blob[ var->blob_length ] = '\0';
+
+	odbc_stats_record( db, ODBC_PHASE_GETDATA, start );
+	odbc_stats_transfer( db, 0, var->blob_length );
+
+	odbc_log( db, "+++ BLOB data for column %d: length = %d, chunks = %d, data = '%.*s'\n",
+			  var->column,
+			  var->blob_length,
+			  chunks,
+			  var->blob_length < 4096 ? var->blob_length : 4096,
+			  var->blob );
+
+	return 1;
+}
+
+/*
+ * odbc_variable_overflow
+ *
+ * Returns 1 if the current row's value of a string or BLOB column can only be read with SQLGetData
+ */
+
+int odbc_variable_overflow( ODBCDatabaseVariable *var )
+{
+	if ( var->cbData == SQL_NULL_DATA )													return 0;
+	if ( var->rows_string && var->cbData >= 0 && var->cbData < var->data_string_size )	return 0;
+	if ( var->type == ODBC_STRING && !var->overflow )									return 0;
+
+	return 1;
+}
+
+/*
+ * odbc_store_keep
+ *
+ * Copies a value that was stored unread into the row store once the script has read it
+ */
+
+void odbc_store_keep( ODBCDatabase *db, ODBCDatabaseVariable *var )
+{
+	ODBCLateValue *late;
+
+	late			= ( ODBCLateValue * ) odbc_allocate( db, sizeof( ODBCLateValue ) + var->blob_length + 1 );
+	late->next		= var->data_store->late;
+	late->cbData	= var->blob_null ? SQL_NULL_DATA : var->blob_length;
+
+	memcpy( late + 1, var->blob, var->blob_length );
+	( ( char * ) ( late + 1 ) )[ var->blob_length ] = '\0';
+
+	var->data_store->late	= late;
+	*var->data_slot			= late;
+	var->data_slot			= NULL;
+}
+
+/*
+ * odbc_variable_string
+ *
+ * Returns the string value of a column variable for the current row, reading values that did not
+ * fit their bound buffer with SQLGetData.
+ */
+
+int odbc_variable_string( ODBCDatabase *db, ODBCDatabaseVariable *var, char **value, int *value_length )
+{
+	if ( var->cbData == SQL_NULL_DATA )
+	{
+		*value			= "";
+		*value_length	= 0;
+
+		return 1;
+	}
+	else if ( var->data_stored || ( var->rows_string && var->cbData >= 0 && var->cbData < var->data_string_size ) )
+	{
+		*value			= var->data_string;
+		*value_length	= var->cbData;
+
+		return 1;
+	}
+	else if ( var->type == ODBC_STRING && !var->overflow )
+	{
+		/* Truncated by the driver without a way to read the rest */
+
+		*value			= var->data_string;
+		*value_length	= var->data_string_size - 1;
+
+		return 1;
+	}
+	else if ( var->type == ODBC_STRING || var->type == ODBC_BLOB )
+	{
+		if ( !var->blob_cached )
+		{
+			if ( !odbc_blob_read( db, var ) )
+			{
+				var->blob_cached = 0;
+				return 0;
+			}
+
+			if ( var->data_slot )	odbc_store_keep( db, var );
+		}
+
+		if ( var->blob_null || var->blob == NULL )
+		{
+			*value			= "";
+			*value_length	= 0;
+
+			return 1;
+		}
+
+		*value			= var->blob;
+		*value_length	= var->blob_length;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * odbc_select_row
+ *
+ * Points the column variables at one row of the rowset buffers
+ */
+
+void odbc_select_row( ODBCDatabaseView *view, int index )
+{
+	int i;
+	ODBCDatabaseVariable *odbcvar;
+
+	for ( i = 0; i < view->column_count; i++ )
+	{
+		odbcvar = view->columns[ i ];
+
+		switch ( odbcvar->type )
+		{
+			case ODBC_INTEGER	: odbcvar->data_integer	= ODBC_ROWSET_BUFFER( view, int, odbcvar->rows_integer )[ index ];		break;
+			case ODBC_DOUBLE	: odbcvar->data_double	= ODBC_ROWSET_BUFFER( view, double, odbcvar->rows_double )[ index ];	break;
+			case ODBC_STRING	:
+			{
+				odbcvar->data_string	= &ODBC_ROWSET_BUFFER( view, char, odbcvar->rows_string )[ index * odbcvar->data_string_size ];
+				odbcvar->data_blob_row	= ( view->rowset_size > 1 ) ? index + 1 : 0;
+				odbcvar->data_stored	= 0;
+				odbcvar->data_slot		= NULL;
+				odbcvar->blob_cached	= 0;
+				break;
+			}
+			case ODBC_BLOB		:
+			{
+				odbcvar->data_blob_row	= ( view->rowset_size > 1 ) ? index + 1 : 0;
+				odbcvar->data_stored	= 0;
+				odbcvar->data_slot		= NULL;
+				odbcvar->blob_cached	= 0;
+
+				if ( odbcvar->rows_string == NULL )
+				{
+					/* Not bound, whether the value is NULL is only known once odbc_blob_read has run */
+
+					odbcvar->cbData = 0;
+					continue;
+				}
+
+				odbcvar->data_string = &ODBC_ROWSET_BUFFER( view, char, odbcvar->rows_string )[ index * odbcvar->data_string_size ];
+				break;
+			}
+		}
+
+		odbcvar->cbData = ( SDWORD ) ODBC_ROWSET_BUFFER( view, SQLLEN, odbcvar->rows_cbData )[ index ];
+
+		if ( odbcvar->type == ODBC_STRING && odbcvar->cbData > odbcvar->observed_size )
+		{
+			odbcvar->observed_size = odbcvar->cbData;
+		}
+	}
+
+	view->deleted->data_integer	= ( ODBC_ROWSET_BUFFER( view, SQLUSMALLINT, view->rowset_status )[ index ] == SQL_ROW_DELETED ) ? 1 : 0;
+}
+
+/*
+ * odbc_store_create
+ */
+
+ODBCRowStore *odbc_store_create( ODBCDatabase *db )
+{
+	ODBCRowStore *store;
+
+	store				= ( ODBCRowStore * ) odbc_allocate( db, sizeof( ODBCRowStore ) );
+	memset( store, 0, sizeof( ODBCRowStore ) );
+
+	store->first_row	= 1;
+	store->next_row		= 1;
+	store->limit		= db->firehose_store;
+	store->spill		= db->store_spill && ( db->firehose_store > 0 );
+	store->spill_file	= INVALID_HANDLE_VALUE;
+
+	return store;
+}
+
+/*
+ * odbc_store_free
+ */
+
+void odbc_store_free( ODBCRowStore *store )
+{
+	ODBCRowChunk *chunk, *next;
+	ODBCLateValue *late, *next_late;
+
+	for ( chunk = store->shared ? NULL : store->first; chunk; chunk = next )
+	{
+		next = chunk->next;
+		mvProgram_Free( NULL, chunk );
+	}
+
+	for ( late = store->late; late; late = next_late )
+	{
+		next_late = late->next;
+		mvProgram_Free( NULL, late );
+	}
+
+	if ( store->window )							UnmapViewOfFile( store->window );
+	if ( store->map )								CloseHandle( store->map );
+	if ( store->spill_file != INVALID_HANDLE_VALUE )	CloseHandle( store->spill_file );
+	if ( store->spill_chunks )						mvProgram_Free( NULL, store->spill_chunks );
+
+	mvProgram_Free( NULL, store );
+}
+
+/*
+ * odbc_store_spill
+ *
+ * Appends a chunk evicted from memory to the store's temporary file
+ */
+
+int odbc_store_spill( ODBCDatabaseView *view, ODBCRowChunk *chunk )
+{
+	DWORD length, written;
+	char path[ MAX_PATH ], name[ MAX_PATH ];
+	ODBCRowStore *store;
+	ODBCSpillChunk *spill_chunks;
+
+	store = view->store;
+
+	if ( store->spill_file == INVALID_HANDLE_VALUE )
+	{
+		if ( ( GetTempPath( sizeof( path ), path ) == 0 ) || ( GetTempFileName( path, "mvd", 0, name ) == 0 ) )
+		{
+			odbc_log( view->db, "+++ Unable to name the row store spill file, dropping rows instead\n" );
+			store->spill = 0;
+
+			return 0;
+		}
+
+		store->spill_file = CreateFile( name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+										FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL );
+
+		if ( store->spill_file == INVALID_HANDLE_VALUE )
+		{
+			odbc_log( view->db, "+++ Unable to create the row store spill file '%s', dropping rows instead\n", name );
+			store->spill = 0;
+
+			return 0;
+		}
+
+		odbc_log( view->db, "--- Row store spilling to '%s'\n", name );
+	}
+
+	if ( store->spill_count == store->spill_capacity )
+	{
+		store->spill_capacity	= store->spill_capacity ? store->spill_capacity * 2 : 64;
+		spill_chunks			= ( ODBCSpillChunk * ) odbc_allocate( view->db, sizeof( ODBCSpillChunk ) * store->spill_capacity );
+
+		if ( store->spill_chunks )
+		{
+			memcpy( spill_chunks, store->spill_chunks, sizeof( ODBCSpillChunk ) * store->spill_count );
+			mvProgram_Free( NULL, store->spill_chunks );
+		}
+
+		store->spill_chunks		= spill_chunks;
+	}
+
+	length = ( DWORD ) ( sizeof( ODBCRowChunk ) + chunk->used );
+
+	if ( !WriteFile( store->spill_file, chunk, length, &written, NULL ) || written != length )
+	{
+		odbc_log( view->db, "+++ Row store spill write failed (%u), dropping rows instead\n", ( unsigned int ) GetLastError() );
+		store->spill = 0;
+
+		return 0;
+	}
+
+	store->spill_chunks[ store->spill_count ].first_row	= chunk->first_row;
+	store->spill_chunks[ store->spill_count ].rows		= chunk->rows;
+	store->spill_chunks[ store->spill_count ].offset	= store->spill_size;
+	store->spill_chunks[ store->spill_count ].length	= length;
+	store->spill_count++;
+	store->spill_size									+= length;
+
+	return 1;
+}
+
+/*
+ * odbc_store_spilled
+ *
+ * Maps the spilled chunk holding a row and returns it.  The last window stays mapped, so walking
+ * rows of the same chunk does not remap the file.
+ */
+
+ODBCRowChunk *odbc_store_spilled( ODBCDatabaseView *view, int row )
+{
+	int low, high, middle;
+	ULONGLONG offset;
+	ODBCRowStore *store;
+	ODBCSpillChunk *spilled;
+
+	store = view->store;
+
+	for ( low = 0, high = store->spill_count - 1, spilled = NULL; low <= high; )
+	{
+		middle = ( low + high ) / 2;
+
+		if ( row < store->spill_chunks[ middle ].first_row )										high	= middle - 1;
+		else if ( row >= store->spill_chunks[ middle ].first_row + store->spill_chunks[ middle ].rows )	low		= middle + 1;
+		else
+		{
+			spilled = &store->spill_chunks[ middle ];
+			break;
+		}
+	}
+
+	if ( spilled == NULL )
+	{
+		return NULL;
+	}
+
+	if ( store->window && spilled->offset >= store->window_offset && spilled->offset + spilled->length <= store->window_offset + store->window_length )
+	{
+		return ( ODBCRowChunk * ) ( store->window + ( spilled->offset - store->window_offset ) );
+	}
+
+	if ( store->window )
+	{
+		UnmapViewOfFile( store->window );
+		store->window = NULL;
+	}
+
+	if ( store->map && store->map_size < spilled->offset + spilled->length )
+	{
+		CloseHandle( store->map );
+		store->map = NULL;
+	}
+
+	if ( store->map == NULL )
+	{
+		if ( ( store->map = CreateFileMapping( store->spill_file, NULL, PAGE_READONLY, 0, 0, NULL ) ) == NULL )
+		{
+			odbc_log( view->db, "+++ CreateFileMapping failed (%u)\n", ( unsigned int ) GetLastError() );
+			return NULL;
+		}
+
+		store->map_size = store->spill_size;
+	}
+
+	offset					= spilled->offset - ( spilled->offset % ODBC_SPILL_GRANULARITY );
+	store->window_offset	= offset;
+	store->window_length	= spilled->offset + spilled->length - offset;
+	store->window			= ( char * ) MapViewOfFile( store->map, FILE_MAP_READ, ( DWORD ) ( offset >> 32 ), ( DWORD ) offset, ( SIZE_T ) store->window_length );
+
+	if ( store->window == NULL )
+	{
+		odbc_log( view->db, "+++ MapViewOfFile failed (%u)\n", ( unsigned int ) GetLastError() );
+		return NULL;
+	}
+
+	return ( ODBCRowChunk * ) ( store->window + ( spilled->offset - offset ) );
+}
+
+/*
+ * odbc_store_append
+ *
+ * Copies the currently selected row of the view into the row store.  Values that did not fit their
+ * bound buffer are only read now if the store is eager, see ODBCRowStore.
+ */
+
+int odbc_store_append( ODBCDatabaseView *view )
+{
+	int i, size, length;
+	char *data, *value;
+	ODBCRowStore *store;
+	ODBCRowChunk *chunk;
+	ODBCDatabaseVariable *odbcvar;
+
+	store = view->store;
+
+	/*
+	 * The indicator of a value read with SQLGetData is only that of the bound prefix, or nothing at
+	 * all for an unbound BLOB, so NULLs are taken from odbc_blob_read
+	 */
+
+	for ( i = 0, size = 0; i < view->column_count; i++ )
+	{
+		odbcvar	= view->columns[ i ];
+		size	+= ODBC_STORE_ALIGN( sizeof( SQLLEN ) );
+
+		switch ( odbcvar->type )
+		{
+			case ODBC_INTEGER	: size += ODBC_STORE_ALIGN( sizeof( int ) );		break;
+			case ODBC_DOUBLE	: size += ODBC_STORE_ALIGN( sizeof( double ) );		break;
+			default				:
+			{
+				if ( odbcvar->cbData == SQL_NULL_DATA )	break;
+
+				if ( !store->eager && odbc_variable_overflow( odbcvar ) )
+				{
+					odbcvar->cbData	= ODBC_STORE_DEFERRED;
+					size			+= ODBC_STORE_ALIGN( sizeof( ODBCLateValue * ) );
+					break;
+				}
+
+				if ( !odbc_variable_string( view->db, odbcvar, &value, &length ) )
+				{
+					return 0;
+				}
+
+				if ( odbcvar->blob_cached && odbcvar->blob_null )
+				{
+					odbcvar->cbData = SQL_NULL_DATA;
+					break;
+				}
+
+				size += ODBC_STORE_ALIGN( length + 1 );
+				break;
+			}
+		}
+	}
+
+	chunk = store->last;
+
+	if ( ( chunk == NULL ) || ( chunk->rows == ODBC_STORE_CHUNK_ROWS ) || ( chunk->used + size > chunk->size ) )
+	{
+		length				= ( size > ODBC_STORE_CHUNK_SIZE ) ? size : ODBC_STORE_CHUNK_SIZE;
+		chunk				= ( ODBCRowChunk * ) odbc_allocate( view->db, sizeof( ODBCRowChunk ) + length );
+
+		chunk->next			= NULL;
+		chunk->first_row	= store->next_row;
+		chunk->rows			= 0;
+		chunk->size			= length;
+		chunk->used			= 0;
+
+		if ( store->last )	store->last->next	= chunk;
+		else				store->first		= chunk;
+
+		store->last			= chunk;
+		store->bytes		+= length;
+	}
+
+	chunk->offsets[ chunk->rows++ ]	= chunk->used;
+	data							= ( char * ) ( chunk + 1 ) + chunk->used;
+	chunk->used						+= size;
+
+	for ( i = 0; i < view->column_count; i++ )
+	{
+		odbcvar = view->columns[ i ];
+
+		if ( ( odbcvar->type == ODBC_STRING || odbcvar->type == ODBC_BLOB ) && odbcvar->cbData != SQL_NULL_DATA && odbcvar->cbData != ODBC_STORE_DEFERRED )
+		{
+			odbc_variable_string( view->db, odbcvar, &value, &length );
+			*( SQLLEN * ) data = length;
+		}
+		else
+		{
+			*( SQLLEN * ) data = odbcvar->cbData;
+		}
+
+		data += ODBC_STORE_ALIGN( sizeof( SQLLEN ) );
+
+		switch ( odbcvar->type )
+		{
+			case ODBC_INTEGER	: *( int * ) data		= odbcvar->data_integer;	data += ODBC_STORE_ALIGN( sizeof( int ) );		break;
+			case ODBC_DOUBLE	: *( double * ) data	= odbcvar->data_double;		data += ODBC_STORE_ALIGN( sizeof( double ) );	break;
+			default				:
+			{
+				if ( odbcvar->cbData == SQL_NULL_DATA )	break;
+
+				if ( odbcvar->cbData == ODBC_STORE_DEFERRED )
+				{
+					*( ODBCLateValue ** ) data	= NULL;
+					data						+= ODBC_STORE_ALIGN( sizeof( ODBCLateValue * ) );
+					store->deferred++;
+					break;
+				}
+
+				memcpy( data, value, length );
+				data[ length ]	= '\0';
+				data			+= ODBC_STORE_ALIGN( length + 1 );
+				break;
+			}
+		}
+	}
+
+	store->next_row++;
+
+	while ( ( store->limit > 0 ) && ( store->bytes > store->limit ) && ( store->first != store->last ) )
+	{
+		chunk				= store->first;
+		store->first		= chunk->next;
+		store->bytes		-= chunk->size;
+
+		if ( !store->spill || !odbc_store_spill( view, chunk ) )
+		{
+			store->first_row = store->first->first_row;
+		}
+
+		mvProgram_Free( NULL, chunk );
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_store_rowset
+ *
+ * Adds the rows just fetched into the rowset buffers to the row store
+ */
+
+int odbc_store_rowset( ODBCDatabaseView *view, int count )
+{
+	int index;
+
+	for ( index = 0; index < count; index++ )
+	{
+		odbc_select_row( view, index );
+
+		if ( !odbc_store_append( view ) )	return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_store_cursor
+ *
+ * Returns the SQLSetPos position of a stored row that the cursor is still on, as used by
+ * odbc_blob_read, or -1 if the cursor has moved past it
+ */
+
+int odbc_store_cursor( ODBCDatabaseView *view, int row )
+{
+	if ( view->store->complete || view->hSTMT == SQL_NULL_HSTMT )
+	{
+		return -1;
+	}
+
+	if ( view->rowset_size > 1 )
+	{
+		return ( row >= view->rowset_first && row < view->rowset_first + ( int ) view->rowset_count ) ? row - view->rowset_first + 1 : -1;
+	}
+
+	return ( row == view->store->next_row - 1 ) ? 0 : -1;
+}
+
+/*
+ * odbc_store_load
+ *
+ * Serves a row that the firehose cursor has already passed from the row store
+ */
+
+int odbc_store_load( ODBCDatabaseView *view, int row )
+{
+	int i, spilled;
+	char *data;
+	SQLLEN cbData;
+	ODBCRowStore *store;
+	ODBCRowChunk *chunk;
+	ODBCLateValue *late;
+	ODBCDatabaseVariable *odbcvar;
+
+	store = view->store;
+
+	if ( row >= store->next_row || row < 1 )
+	{
+		view->recno->data_integer	= ( row < 1 ) ? view->recno->data_integer : store->next_row;
+		view->eof->data_integer		= 1;
+
+		return 1;
+	}
+
+	if ( row < store->first_row )
+	{
+		sprintf( view->db->error, "Row %d is no longer held by the row store, the oldest row available is %d", row, store->first_row );
+		return 0;
+	}
+
+	spilled = ( row < store->first->first_row );
+
+	if ( !spilled )
+	{
+		for ( chunk = store->first; chunk->first_row + chunk->rows <= row; chunk = chunk->next );
+	}
+	else if ( ( chunk = odbc_store_spilled( view, row ) ) == NULL )
+	{
+		sprintf( view->db->error, "Unable to read row %d from the row store spill file", row );
+		return 0;
+	}
+
+	data = ( char * ) ( chunk + 1 ) + chunk->offsets[ row - chunk->first_row ];
+
+	for ( i = 0; i < view->column_count; i++ )
+	{
+		odbcvar				= view->columns[ i ];
+		cbData				= *( SQLLEN * ) data;
+		data				+= ODBC_STORE_ALIGN( sizeof( SQLLEN ) );
+		odbcvar->cbData		= ( SDWORD ) cbData;
+
+		switch ( odbcvar->type )
+		{
+			case ODBC_INTEGER	: odbcvar->data_integer	= *( int * ) data;		data += ODBC_STORE_ALIGN( sizeof( int ) );		break;
+			case ODBC_DOUBLE	: odbcvar->data_double	= *( double * ) data;	data += ODBC_STORE_ALIGN( sizeof( double ) );	break;
+			default				:
+			{
+				odbcvar->data_stored	= 1;
+				odbcvar->data_slot		= NULL;
+
+				if ( cbData == SQL_NULL_DATA )	break;
+
+				if ( cbData == ODBC_STORE_DEFERRED )
+				{
+					if ( ( late = *( ODBCLateValue ** ) data ) != NULL )
+					{
+						odbcvar->cbData			= ( SDWORD ) late->cbData;
+						odbcvar->data_string	= ( char * ) ( late + 1 );
+					}
+					else
+					{
+						/* Read with SQLGetData if the cursor is still on the row, and kept unless its chunk was spilled */
+
+						odbcvar->cbData			= SQL_NO_TOTAL;
+						odbcvar->data_stored	= 0;
+						odbcvar->blob_cached	= 0;
+						odbcvar->data_blob_row	= odbc_store_cursor( view, row );
+						odbcvar->data_store		= store;
+						odbcvar->data_slot		= spilled ? NULL : ( ODBCLateValue ** ) data;
+					}
+
+					data += ODBC_STORE_ALIGN( sizeof( ODBCLateValue * ) );
+					break;
+				}
+
+				odbcvar->data_string	= data;
+				data					+= ODBC_STORE_ALIGN( cbData + 1 );
+				break;
+			}
+		}
+	}
+
+	view->recno->data_integer	= row;
+	view->eof->data_integer		= 0;
+	view->deleted->data_integer	= 0;
+
+	return 1;
+}
+
+/*
+ * odbc_store_settle
+ *
+ * Reads the values left unread in the stored rows that the cursor is still on, before it moves on.
+ * The view's current row is left as it was.
+ */
+
+int odbc_store_settle( ODBCDatabaseView *view )
+{
+	int i, ok, row, last, length, recno, eof;
+	char *value;
+	ODBCDatabaseVariable *odbcvar;
+
+	if ( view->store->deferred == 0 || view->store->complete )
+	{
+		return 1;
+	}
+
+	if ( view->rowset_size > 1 )
+	{
+		row		= view->rowset_first;
+		last	= view->rowset_first + ( int ) view->rowset_count;
+	}
+	else
+	{
+		row		= view->store->next_row - 1;
+		last	= view->store->next_row;
+	}
+
+	ok		= 1;
+	recno	= view->recno->data_integer;
+	eof		= view->eof->data_integer;
+
+	for ( ; ok && row < last; row++ )
+	{
+		if ( row < view->store->first_row || row >= view->store->next_row )
+		{
+			continue;
+		}
+
+		if ( !odbc_store_load( view, row ) )
+		{
+			ok = 0;
+			break;
+		}
+
+		for ( i = 0; ok && i < view->column_count; i++ )
+		{
+			odbcvar = view->columns[ i ];
+
+			if ( odbcvar->data_slot && !odbc_variable_string( view->db, odbcvar, &value, &length ) )	ok = 0;
+		}
+	}
+
+	view->recno->data_integer	= recno;
+	view->eof->data_integer		= eof;
+
+	return ok;
+}
+
+/*
+ * Result cache
+ *
+ * Complete SELECT results shared by every connection in the process, evicted least recently used
+ * first once odbc_cache_budget bytes are held.  Entries expire after the TTL of the connection that
+ * stored them and are invalidated when MvQUERY writes to one of the tables they reference.
+ *
+ * When odbc_shared_size is set, results are also published to a named mapping so that other
+ * worker processes can reuse them.  Writes in any process advance the mapping's generation
+ * counters, which invalidates the results of every process that depend on them.
+ */
+
+static CRITICAL_SECTION		odbc_cache_lock;
+static ODBCCacheEntry		*odbc_cache_buckets[ ODBC_CACHE_BUCKETS ];
+static ODBCCacheEntry		*odbc_cache_first			= NULL;
+static ODBCCacheEntry		*odbc_cache_last			= NULL;
+static int					odbc_cache_count			= 0;
+static int					odbc_cache_bytes			= 0;
+static int					odbc_cache_budget			= 32 * 1024 * 1024;
+static unsigned int			odbc_cache_hits				= 0;
+static unsigned int			odbc_cache_misses			= 0;
+static unsigned int			odbc_cache_invalidations	= 0;
+static volatile LONG		odbc_cache_shared_hits		= 0;
+static HANDLE				odbc_shared_map				= NULL;
+static ODBCSharedHeader		*odbc_shared				= NULL;		/* Shared tier, NULL when not attached */
+static int					odbc_shared_size			= 0;		/* Megabytes, 0 disables the shared tier */
+static int					odbc_shared_failed			= 0;
+static int					odbc_cache_used				= 0;		/* Set once a view is opened with a cache key */
+
+/*
+ * odbc_cache_release
+ */
+
+void odbc_cache_release( ODBCCacheEntry *entry )
+{
+	ODBCRowChunk *chunk, *next;
+
+	if ( InterlockedDecrement( &entry->references ) != 0 )
+	{
+		return;
+	}
+
+	for ( chunk = entry->first; chunk; chunk = next )
+	{
+		next = chunk->next;
+		mvProgram_Free( NULL, chunk );
+	}
+
+	if ( entry->tables )	mvProgram_Free( NULL, entry->tables );
+
+	mvProgram_Free( NULL, entry->columns );
+	mvProgram_Free( NULL, entry->key );
+	mvProgram_Free( NULL, entry );
+}
+
+/*
+ * odbc_cache_unlink
+ *
+ * Removes an entry from the cache and drops the cache's reference.  Must be called with
+ * odbc_cache_lock held.
+ */
+
+void odbc_cache_unlink( ODBCCacheEntry *entry )
+{
+	ODBCCacheEntry **link;
+
+	for ( link = &odbc_cache_buckets[ entry->hash % ODBC_CACHE_BUCKETS ]; *link != entry; link = &( *link )->bucket_next );
+
+	*link = entry->bucket_next;
+
+	if ( entry->prev )	entry->prev->next	= entry->next;
+	else				odbc_cache_first	= entry->next;
+
+	if ( entry->next )	entry->next->prev	= entry->prev;
+	else				odbc_cache_last		= entry->prev;
+
+	entry->linked		= 0;
+	odbc_cache_bytes	-= entry->bytes;
+	odbc_cache_count--;
+
+	odbc_cache_release( entry );
+}
+
+/*
+ * odbc_cache_trim
+ *
+ * Evicts the least recently used entries until the cache fits within limit bytes.  Must be called
+ * with odbc_cache_lock held.
+ */
+
+void odbc_cache_trim( int limit )
+{
+	while ( odbc_cache_last && odbc_cache_bytes > limit )
+	{
+		odbc_cache_unlink( odbc_cache_last );
+	}
+}
+
+/*
+ * odbc_cache_flush
+ */
+
+void odbc_cache_flush( void )
+{
+	EnterCriticalSection( &odbc_cache_lock );
+	odbc_cache_trim( -1 );
+	LeaveCriticalSection( &odbc_cache_lock );
+}
+
+/*
+ * odbc_cache_discard
+ *
+ * Removes an entry so that later views execute the query again
+ */
+
+void odbc_cache_discard( ODBCCacheEntry *entry )
+{
+	EnterCriticalSection( &odbc_cache_lock );
+	if ( entry->linked )	odbc_cache_unlink( entry );
+	LeaveCriticalSection( &odbc_cache_lock );
+}
+
+/*
+ * odbc_cache_digest
+ *
+ * Computes the digest of a connection's pool key on first use
+ */
+
+int odbc_cache_digest( ODBCPoolConnection *connection )
+{
+	DWORD length;
+	HCRYPTPROV provider;
+	HCRYPTHASH hash;
+
+	if ( connection->digest_valid )
+	{
+		return 1;
+	}
+
+	if ( !CryptAcquireContext( &provider, NULL, NULL, PROV_RSA_AES, CRYPT_VERIFYCONTEXT ) )
+	{
+		return 0;
+	}
+
+	if ( CryptCreateHash( provider, CALG_SHA_256, 0, 0, &hash ) )
+	{
+		length						= sizeof( connection->digest );
+		connection->digest_valid	= CryptHashData( hash, ( BYTE * ) connection->key, connection->key_length, 0 ) &&
+									  CryptGetHashParam( hash, HP_HASHVAL, connection->digest, &length, 0 );
+
+		CryptDestroyHash( hash );
+	}
+
+	CryptReleaseContext( provider, 0 );
+
+	return connection->digest_valid;
+}
+
+/*
+ * odbc_cache_key
+ *
+ * Builds the cache key from the digest of the connection's pool key, the query text and the
+ * parameter values.  Keys are published to the shared tier, so they must not hold the password.
+ * Returns NULL if the digest cannot be computed.
+ */
+
+char *odbc_cache_key( ODBCDatabase *db, const char *query, int query_length, mvVariableList input, int *key_length )
+{
+	int length, value_length;
+	char *key, *data;
+	const char *value;
+	mvVariable variable;
+
+	if ( !odbc_cache_digest( db->connection ) )
+	{
+		return NULL;
+	}
+
+	length = sizeof( db->connection->digest ) + query_length;
+
+	for ( variable = mvVariableList_First( input ); variable; variable = mvVariableList_Next( input ) )
+	{
+		mvVariable_Value( variable, &value_length );
+		length += sizeof( int ) + value_length;
+	}
+
+	key		= ( char * ) odbc_allocate( db, length + 1 );
+	data	= key;
+
+	memcpy( data, db->connection->digest, sizeof( db->connection->digest ) );	data += sizeof( db->connection->digest );
+	memcpy( data, query, query_length );									data += query_length;
+
+	for ( variable = mvVariableList_First( input ); variable; variable = mvVariableList_Next( input ) )
+	{
+		value = mvVariable_Value( variable, &value_length );
+
+		memcpy( data, &value_length, sizeof( int ) );						data += sizeof( int );
+		memcpy( data, value, value_length );								data += value_length;
+	}
+
+	*data		= '\0';
+	*key_length	= length;
+
+	return key;
+}
+
+/*
+ * odbc_shared_security
+ *
+ * Builds a security descriptor whose DACL grants access to the process's user only, so that other
+ * accounts in the session cannot open the mapping.  Returns NULL on failure, the caller frees the
+ * descriptor with LocalFree.
+ */
+
+PSECURITY_DESCRIPTOR odbc_shared_security( void )
+{
+	DWORD length, buffer[ 64 ];
+	HANDLE token;
+	char *sid, sddl[ 256 ];
+	PSECURITY_DESCRIPTOR descriptor;
+
+	descriptor = NULL;
+
+	if ( !OpenProcessToken( GetCurrentProcess(), TOKEN_QUERY, &token ) )
+	{
+		return NULL;
+	}
+
+	if ( GetTokenInformation( token, TokenUser, buffer, sizeof( buffer ), &length ) &&
+		 ConvertSidToStringSidA( ( ( TOKEN_USER * ) buffer )->User.Sid, &sid ) )
+	{
+		sprintf( sddl, "D:P(A;;GA;;;%.200s)", sid );
+		LocalFree( sid );
+
+		if ( !ConvertStringSecurityDescriptorToSecurityDescriptorA( sddl, SDDL_REVISION_1, &descriptor, NULL ) )
+		{
+			descriptor = NULL;
+		}
+	}
+
+	CloseHandle( token );
+
+	return descriptor;
+}
+
+/*
+ * odbc_shared_attach
+ *
+ * Opens or creates the shared tier's mapping on first use.  The process that creates the mapping
+ * sizes it and initializes the header, processes that open it use the existing layout.
+ */
+
+int odbc_shared_attach( ODBCDatabase *db )
+{
+	int i, created, slot_count;
+	DWORD size;
+	HANDLE map;
+	SECURITY_ATTRIBUTES attributes;
+	ODBCSharedHeader *header;
+
+	if ( odbc_shared || odbc_shared_size <= 0 || odbc_shared_failed )
+	{
+		return odbc_shared != NULL;
+	}
+
+	EnterCriticalSection( &odbc_cache_lock );
+
+	if ( odbc_shared == NULL && !odbc_shared_failed )
+	{
+		odbc_shared_failed	= 1;
+		slot_count			= ( int ) ( ( ( ULONGLONG ) odbc_shared_size * 1024 * 1024 - ODBC_SHARED_HEADER_SIZE ) / ODBC_SHARED_SLOT_SIZE );
+		size				= ( DWORD ) ( ODBC_SHARED_HEADER_SIZE + ( ULONGLONG ) slot_count * ODBC_SHARED_SLOT_SIZE );
+		header				= NULL;
+
+		attributes.nLength				= sizeof( SECURITY_ATTRIBUTES );
+		attributes.lpSecurityDescriptor	= odbc_shared_security();
+		attributes.bInheritHandle		= FALSE;
+
+		if ( slot_count > 0 && attributes.lpSecurityDescriptor &&
+			 ( map = CreateFileMapping( INVALID_HANDLE_VALUE, &attributes, PAGE_READWRITE, 0, size, ODBC_SHARED_NAME ) ) != NULL )
+		{
+			created = ( GetLastError() != ERROR_ALREADY_EXISTS );
+
+			if ( ( header = ( ODBCSharedHeader * ) MapViewOfFile( map, FILE_MAP_ALL_ACCESS, 0, 0, 0 ) ) == NULL )
+			{
+				CloseHandle( map );
+			}
+			else if ( created )
+			{
+				header->slot_count	= slot_count;
+				header->slot_size	= ODBC_SHARED_SLOT_SIZE;
+
+				InterlockedExchange( &header->magic, ODBC_SHARED_MAGIC );
+			}
+			else
+			{
+				for ( i = 0; i < 1000 && header->magic != ODBC_SHARED_MAGIC; i++ )	Sleep( 1 );
+
+				if ( header->magic != ODBC_SHARED_MAGIC )
+				{
+					UnmapViewOfFile( header );
+					CloseHandle( map );
+
+					header = NULL;
+				}
+			}
+		}
+
+		if ( header )
+		{
+			odbc_shared				= header;
+			odbc_shared_generations	= &header->counters;
+			odbc_shared_map			= map;
+			odbc_shared_failed		= 0;
+
+			odbc_log( db, "--- Shared result cache attached: slots = %d, slot size = %d\n", header->slot_count, header->slot_size );
+		}
+		else
+		{
+			odbc_log( db, "+++ Unable to attach the shared result cache (%u)\n", ( unsigned int ) GetLastError() );
+		}
+
+		if ( attributes.lpSecurityDescriptor )	LocalFree( attributes.lpSecurityDescriptor );
+	}
+
+	LeaveCriticalSection( &odbc_cache_lock );
+
+	return odbc_shared != NULL;
+}
+
+/*
+ * odbc_shared_tags
+ *
+ * Records the shared tier's current generations of the tables listed in a cache_tables string
+ */
+
+void odbc_shared_tags( const char *tables, ODBCSharedTags *tags )
+{
+	if ( odbc_shared == NULL )
+	{
+		memset( tags, 0, sizeof( ODBCSharedTags ) );
+		return;
+	}
+
+	odbc_generations_capture( &odbc_shared->counters, tables, tags );
+}
+
+/*
+ * odbc_shared_current
+ *
+ * Returns 0 if a write in any process has invalidated a result with the given tags
+ */
+
+int odbc_shared_current( ODBCSharedTags *tags )
+{
+	return odbc_shared == NULL || odbc_generations_current( &odbc_shared->counters, tags );
+}
+
+/*
+ * odbc_shared_written
+ *
+ * Advances the generation of a written table, or the flush count if the table is not known, in
+ * process and in the shared tier
+ */
+
+void odbc_shared_written( const char *table )
+{
+	odbc_generations_advance( &odbc_generations, table );
+
+	if ( odbc_shared )	odbc_generations_advance( &odbc_shared->counters, table );
+}
+
+/*
+ * odbc_shared_slot
+ */
+
+ODBCSharedSlot *odbc_shared_slot( unsigned int hash )
+{
+	return ( ODBCSharedSlot * ) ( ( char * ) odbc_shared + ODBC_SHARED_HEADER_SIZE + ( ULONGLONG ) ( hash % odbc_shared->slot_count ) * odbc_shared->slot_size );
+}
+
+/*
+ * odbc_shared_store
+ *
+ * Publishes a cache entry to its slot.  Results that do not fit in a slot are not shared, and a
+ * slot that another process is writing is left alone.
+ */
+
+void odbc_shared_store( ODBCCacheEntry *entry )
+{
+	int length, chunk_count;
+	LONG sequence;
+	char *data;
+	ODBCRowChunk *chunk;
+	ODBCSharedSlot *slot;
+
+	if ( odbc_shared == NULL )
+	{
+		return;
+	}
+
+	length		= entry->key_length + sizeof( ODBCColumnInfo ) * entry->column_count;
+	chunk_count	= 0;
+
+	for ( chunk = entry->first; chunk; chunk = chunk->next, chunk_count++ )
+	{
+		length += sizeof( int ) * ( 2 + chunk->rows ) + chunk->used;
+	}
+
+	if ( length > odbc_shared->slot_size - ( int ) sizeof( ODBCSharedSlot ) )
+	{
+		return;
+	}
+
+	slot		= odbc_shared_slot( entry->hash );
+	sequence	= slot->sequence;
+
+	if ( ( sequence & 1 ) || InterlockedCompareExchange( &slot->sequence, sequence + 1, sequence ) != sequence )
+	{
+		return;
+	}
+
+	slot->hash			= entry->hash;
+	slot->expires		= entry->expires;
+	slot->tags			= entry->tags;
+	slot->key_length	= entry->key_length;
+	slot->column_count	= entry->column_count;
+	slot->rows			= entry->rows;
+	slot->chunk_count	= chunk_count;
+	slot->data_length	= length;
+
+	data = ( char * ) ( slot + 1 );
+
+	memcpy( data, entry->key, entry->key_length );											data += entry->key_length;
+	memcpy( data, entry->columns, sizeof( ODBCColumnInfo ) * entry->column_count );		data += sizeof( ODBCColumnInfo ) * entry->column_count;
+
+	for ( chunk = entry->first; chunk; chunk = chunk->next )
+	{
+		memcpy( data, &chunk->rows, sizeof( int ) );										data += sizeof( int );
+		memcpy( data, &chunk->used, sizeof( int ) );										data += sizeof( int );
+		memcpy( data, chunk->offsets, sizeof( int ) * chunk->rows );						data += sizeof( int ) * chunk->rows;
+		memcpy( data, chunk + 1, chunk->used );												data += chunk->used;
+	}
+
+	MemoryBarrier();
+	InterlockedExchange( &slot->sequence, sequence + 2 );
+}
+
+/*
+ * odbc_shared_load
+ *
+ * Copies the result for the key out of its slot into a new cache entry, or returns NULL if the
+ * slot holds another key, has expired, has been invalidated or kept changing while being read
+ */
+
+ODBCCacheEntry *odbc_shared_load( ODBCDatabase *db, const char *key, int key_length, unsigned int hash )
+{
+	int attempt, row, rows, used;
+	LONG sequence;
+	char *buffer, *data, *end;
+	ODBCSharedSlot *slot, copy;
+	ODBCRowChunk *chunk, **link;
+	ODBCCacheEntry *entry;
+
+	if ( odbc_shared == NULL )
+	{
+		return NULL;
+	}
+
+	slot	= odbc_shared_slot( hash );
+	buffer	= NULL;
+
+	for ( attempt = 0; attempt < 3; attempt++ )
+	{
+		if ( ( sequence = slot->sequence ) & 1 )
+		{
+			Sleep( 0 );
+			continue;
+		}
+
+		MemoryBarrier();
+		copy = *slot;
+
+		if ( sequence == 0 || copy.hash != hash || copy.key_length != key_length )
+		{
+			break;
+		}
+
+		if ( copy.data_length < key_length || copy.data_length > odbc_shared->slot_size - ( int ) sizeof( ODBCSharedSlot ) )
+		{
+			continue;
+		}
+
+		if ( buffer )	mvProgram_Free( NULL, buffer );
+		buffer = ( char * ) odbc_allocate( db, copy.data_length );
+
+		memcpy( buffer, slot + 1, copy.data_length );
+		MemoryBarrier();
+
+		if ( slot->sequence == sequence )
+		{
+			break;
+		}
+
+		mvProgram_Free( NULL, buffer );
+		buffer = NULL;
+	}
+
+	if ( buffer == NULL )
+	{
+		return NULL;
+	}
+
+	if ( memcmp( buffer, key, key_length ) || copy.expires <= GetTickCount64() || !odbc_shared_current( &copy.tags ) )
+	{
+		mvProgram_Free( NULL, buffer );
+		return NULL;
+	}
+
+	entry					= ( ODBCCacheEntry * ) odbc_allocate( db, sizeof( ODBCCacheEntry ) );
+	memset( entry, 0, sizeof( ODBCCacheEntry ) );
+
+	entry->references		= 2;
+	entry->hash				= hash;
+	entry->key_length		= key_length;
+	entry->key				= ( char * ) odbc_allocate( db, key_length + 1 );
+	entry->expires			= copy.expires;
+	entry->tags				= copy.tags;
+	entry->rows				= copy.rows;
+	entry->column_count		= copy.column_count;
+	entry->columns			= ( ODBCColumnInfo * ) odbc_allocate( db, sizeof( ODBCColumnInfo ) * ( copy.column_count + 1 ) );
+	entry->bytes			= copy.data_length;
+
+	memcpy( entry->key, buffer, key_length );
+	entry->key[ key_length ] = '\0';
+
+	data	= buffer + key_length;
+	end		= buffer + copy.data_length;
+
+	memcpy( entry->columns, data, sizeof( ODBCColumnInfo ) * copy.column_count );
+	data	+= sizeof( ODBCColumnInfo ) * copy.column_count;
+
+	for ( row = 1, link = &entry->first; copy.chunk_count-- > 0; link = &chunk->next )
+	{
+		memcpy( &rows, data, sizeof( int ) );	data += sizeof( int );
+		memcpy( &used, data, sizeof( int ) );	data += sizeof( int );
+
+		chunk				= ( ODBCRowChunk * ) odbc_allocate( db, sizeof( ODBCRowChunk ) + used );
+		chunk->next			= NULL;
+		chunk->first_row	= row;
+		chunk->rows			= rows;
+		chunk->size			= used;
+		chunk->used			= used;
+
+		memcpy( chunk->offsets, data, sizeof( int ) * rows );	data += sizeof( int ) * rows;
+		memcpy( chunk + 1, data, used );						data += used;
+
+		*link				= chunk;
+		entry->last			= chunk;
+		row					+= rows;
+	}
+
+	mvProgram_Free( NULL, buffer );
+
+	if ( data != end || row != entry->rows + 1 )
+	{
+		odbc_cache_release( entry );
+		odbc_cache_release( entry );
+
+		return NULL;
+	}
+
+	return entry;
+}
+
+/*
+ * odbc_cache_link
+ *
+ * Adds an entry to the cache, replacing any entry with the same key
+ */
+
+void odbc_cache_link( ODBCCacheEntry *entry )
+{
+	ODBCCacheEntry *existing;
+
+	EnterCriticalSection( &odbc_cache_lock );
+
+	for ( existing = odbc_cache_buckets[ entry->hash % ODBC_CACHE_BUCKETS ]; existing; existing = existing->bucket_next )
+	{
+		if ( existing->hash == entry->hash && existing->key_length == entry->key_length && !memcmp( existing->key, entry->key, entry->key_length ) )
+		{
+			odbc_cache_unlink( existing );
+			break;
+		}
+	}
+
+	entry->linked			= 1;
+	entry->bucket_next		= odbc_cache_buckets[ entry->hash % ODBC_CACHE_BUCKETS ];
+	odbc_cache_buckets[ entry->hash % ODBC_CACHE_BUCKETS ] = entry;
+
+	entry->prev				= NULL;
+	entry->next				= odbc_cache_first;
+	if ( odbc_cache_first )	odbc_cache_first->prev	= entry;
+	else					odbc_cache_last			= entry;
+	odbc_cache_first		= entry;
+
+	odbc_cache_bytes		+= entry->bytes;
+	odbc_cache_count++;
+
+	odbc_cache_trim( odbc_cache_budget );
+
+	LeaveCriticalSection( &odbc_cache_lock );
+}
+
+/*
+ * odbc_cache_lookup
+ *
+ * Returns the current entry for the key with a reference added for the caller, or NULL.  Keys
+ * missing from the process's cache are looked up in the shared tier.
+ */
+
+ODBCCacheEntry *odbc_cache_lookup( ODBCDatabase *db, const char *key, int key_length, unsigned int hash )
+{
+	ODBCCacheEntry *entry;
+
+	EnterCriticalSection( &odbc_cache_lock );
+
+	for ( entry = odbc_cache_buckets[ hash % ODBC_CACHE_BUCKETS ]; entry; entry = entry->bucket_next )
+	{
+		if ( entry->hash == hash && entry->key_length == key_length && !memcmp( entry->key, key, key_length ) )
+		{
+			break;
+		}
+	}
+
+	if ( entry && ( entry->expires <= GetTickCount64() || !odbc_shared_current( &entry->tags ) || !odbc_generations_current( &odbc_generations, &entry->local ) ) )
+	{
+		odbc_cache_unlink( entry );
+		entry = NULL;
+	}
+
+	if ( entry == NULL )
+	{
+		odbc_cache_misses++;
+		LeaveCriticalSection( &odbc_cache_lock );
+
+		if ( ( entry = odbc_shared_load( db, key, key_length, hash ) ) != NULL )
+		{
+			odbc_cache_link( entry );
+			InterlockedIncrement( &odbc_cache_shared_hits );
+		}
+
+		return entry;
+	}
+
+	if ( entry->prev )
+	{
+		entry->prev->next	= entry->next;
+
+		if ( entry->next )	entry->next->prev	= entry->prev;
+		else				odbc_cache_last		= entry->prev;
+
+		entry->prev			= NULL;
+		entry->next			= odbc_cache_first;
+		odbc_cache_first->prev	= entry;
+		odbc_cache_first	= entry;
+	}
+
+	InterlockedIncrement( &entry->references );
+	odbc_cache_hits++;
+
+	LeaveCriticalSection( &odbc_cache_lock );
+	return entry;
+}
+
+/*
+ * odbc_cache_insert
+ *
+ * Moves the rows of a complete firehose view into a new cache entry, which the view then reads
+ * in place.  Results that lost rows to the store limit or a fast skip, or that would take more
+ * than a quarter of the budget, are not cached.
+ */
+
+void odbc_cache_insert( ODBCDatabaseView *view )
+{
+	ODBCRowStore *store;
+	ODBCCacheEntry *entry;
+
+	store = view->store;
+
+	if ( store->first_row != 1 || store->spill_count || store->deferred || store->bytes > odbc_cache_budget / 4 )
+	{
+		odbc_log( view->db, "+++ Result not cached: %d bytes held, first row %d, %d values unread\n", store->bytes, store->first_row, store->deferred );
+		return;
+	}
+
+	/* The lock is held until the entry is linked, so that a write racing with the check
+	   either stops the insert or finds the entry and unlinks it */
+
+	EnterCriticalSection( &odbc_cache_lock );
+
+	if ( !odbc_generations_current( &odbc_generations, &view->cache_local ) )
+	{
+		LeaveCriticalSection( &odbc_cache_lock );
+
+		odbc_log( view->db, "+++ Result not cached: a table it reads was written while it was open\n" );
+		return;
+	}
+
+	entry					= ( ODBCCacheEntry * ) odbc_allocate( view->db, sizeof( ODBCCacheEntry ) );
+	memset( entry, 0, sizeof( ODBCCacheEntry ) );
+
+	entry->references		= 2;
+	entry->key				= view->cache_key;
+	entry->key_length		= view->cache_key_length;
+	entry->hash				= view->cache_hash;
+	entry->tables			= view->cache_tables;
+	entry->expires			= GetTickCount64() + ( ULONGLONG ) view->db->result_cache * 1000;
+	entry->bytes			= store->bytes + sizeof( ODBCColumnInfo ) * view->shape->column_count + entry->key_length;
+	entry->rows				= store->next_row - 1;
+	entry->first			= store->first;
+	entry->last				= store->last;
+	entry->column_count		= view->shape->column_count;
+	entry->columns			= ( ODBCColumnInfo * ) odbc_allocate( view->db, sizeof( ODBCColumnInfo ) * ( entry->column_count + 1 ) );
+	entry->tags				= view->cache_tags;
+	entry->local			= view->cache_local;
+
+	memcpy( entry->columns, view->shape->columns, sizeof( ODBCColumnInfo ) * entry->column_count );
+
+	view->cached			= entry;
+	view->cache_key			= NULL;
+	view->cache_tables		= NULL;
+	store->shared			= 1;
+
+	odbc_cache_link( entry );
+
+	LeaveCriticalSection( &odbc_cache_lock );
+
+	odbc_shared_store( entry );
+
+	odbc_log( view->db, "--- Result cached: rows = %d, bytes = %d\n", entry->rows, entry->bytes );
+}
+
+/*
+ * odbc_cache_word
+ *
+ * Returns 1 if the lowercase keyword appears in text at offset as a whole word
+ */
+
+#define ODBC_SPACE_CHAR( c )		( ( c ) == ' ' || ( c ) == '\t' || ( c ) == '\r' || ( c ) == '\n' )
+#define ODBC_IDENTIFIER_CHAR( c )	( ( ( c ) >= 'a' && ( c ) <= 'z' ) || ( ( c ) >= 'A' && ( c ) <= 'Z' ) || ( ( c ) >= '0' && ( c ) <= '9' ) || ( c ) == '_' || ( c ) == '$' || ( c ) == '#' )
+
+int odbc_cache_word( const char *text, int text_length, int offset, const char *keyword )
+{
+	int i;
+
+	if ( offset > 0 && ODBC_IDENTIFIER_CHAR( text[ offset - 1 ] ) )
+	{
+		return 0;
+	}
+
+	for ( i = 0; keyword[ i ]; i++ )
+	{
+		if ( offset + i == text_length || ( text[ offset + i ] | 0x20 ) != keyword[ i ] )	return 0;
+	}
+
+	return ( offset + i == text_length ) || !ODBC_IDENTIFIER_CHAR( text[ offset + i ] );
+}
+
+/*
+ * odbc_cache_table
+ *
+ * Reads the table name at offset, skipping leading whitespace, and stores its last name part in
+ * lowercase and without quoting into name.  Returns the offset following the name, or 0 if there
+ * is no name at offset.
+ */
+
+int odbc_cache_table( const char *text, int text_length, int offset, char *name, int name_size )
+{
+	int start, length;
+	char c;
+
+	while ( offset < text_length && ODBC_SPACE_CHAR( text[ offset ] ) )	offset++;
+
+	for ( start = offset, length = 0; offset < text_length; offset++ )
+	{
+		c = text[ offset ];
+
+		if		( c == '.' )											length = 0;
+		else if	( c == '"' || c == '`' || c == '[' || c == ']' )		continue;
+		else if	( !ODBC_IDENTIFIER_CHAR( c ) )							break;
+		else if	( length < name_size - 1 )								name[ length++ ] = ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+	}
+
+	name[ length ] = '\0';
+
+	return ( offset > start && length ) ? offset : 0;
+}
+
+/*
+ * odbc_cache_tables
+ *
+ * Returns the tables following FROM and JOIN in a SELECT statement as "|name|name|", or NULL if
+ * there are too many to track, in which case every write invalidates the entry.  Subqueries are
+ * found by the same scan, so only comma separated table lists need to be followed here.
+ */
+
+char *odbc_cache_tables( ODBCDatabase *db, const char *query, int query_length )
+{
+	int i, next, length;
+	char *tables, name[ 129 ], buffer[ 1024 ];
+
+	buffer[ 0 ]	= '|';
+	buffer[ 1 ]	= '\0';
+	length		= 1;
+
+	for ( i = 0; i < query_length; i++ )
+	{
+		if ( query[ i ] == '\'' )
+		{
+			for ( i++; i < query_length && query[ i ] != '\''; i++ );
+			continue;
+		}
+
+		if ( !odbc_cache_word( query, query_length, i, "from" ) && !odbc_cache_word( query, query_length, i, "join" ) )
+		{
+			continue;
+		}
+
+		for ( i += 4; ( next = odbc_cache_table( query, query_length, i, name, sizeof( name ) ) ) != 0; i++ )
+		{
+			if ( length + ( int ) strlen( name ) + 2 > ( int ) sizeof( buffer ) )
+			{
+				return NULL;
+			}
+
+			length += sprintf( &buffer[ length ], "%s|", name );
+
+			/* Skip an alias, then continue with the next table of a comma separated list */
+
+			for ( i = next; i < query_length && ODBC_SPACE_CHAR( query[ i ] ); i++ );
+
+			if ( odbc_cache_word( query, query_length, i, "as" ) )
+			{
+				for ( i += 2; i < query_length && ODBC_SPACE_CHAR( query[ i ] ); i++ );
+			}
+
+			if ( !odbc_cache_word( query, query_length, i, "join" ) && !odbc_cache_word( query, query_length, i, "from" ) )
+			{
+				for ( ; i < query_length && ( ODBC_IDENTIFIER_CHAR( query[ i ] ) || query[ i ] == '"' || query[ i ] == '`' || query[ i ] == '[' || query[ i ] == ']' ); i++ );
+				for ( ; i < query_length && ODBC_SPACE_CHAR( query[ i ] ); i++ );
+			}
+
+			if ( i == query_length || query[ i ] != ',' )	break;
+		}
+
+		i--;
+	}
+
+	tables = ( char * ) odbc_allocate( db, length + 1 );
+	memcpy( tables, buffer, length + 1 );
+
+	return tables;
+}
+
+/*
+ * odbc_cache_target
+ *
+ * Copies the name of the table written by an MvQUERY statement, returns 0 if it is not recognized
+ */
+
+int odbc_cache_target( const char *query, int query_length, char *name, int name_size )
+{
+	int offset;
+
+	if		( ( offset = odbc_keyword( query, query_length, "insert" ) ) != 0 )		offset += odbc_keyword( &query[ offset ], query_length - offset, "into" );
+	else if	( ( offset = odbc_keyword( query, query_length, "replace" ) ) != 0 )	offset += odbc_keyword( &query[ offset ], query_length - offset, "into" );
+	else if	( ( offset = odbc_keyword( query, query_length, "merge" ) ) != 0 )		offset += odbc_keyword( &query[ offset ], query_length - offset, "into" );
+	else if	( ( offset = odbc_keyword( query, query_length, "delete" ) ) != 0 )		offset += odbc_keyword( &query[ offset ], query_length - offset, "from" );
+	else if	( ( offset = odbc_keyword( query, query_length, "truncate" ) ) != 0 )	offset += odbc_keyword( &query[ offset ], query_length - offset, "table" );
+	else																			offset = odbc_keyword( query, query_length, "update" );
+
+	return offset != 0 && odbc_cache_table( query, query_length, offset, name, name_size ) != 0;
+}
+
+/*
+ * odbc_cache_invalidate
+ *
+ * Drops the entries that reference the table written by an MvQUERY statement.  Statements whose
+ * target table is not recognized, such as procedure calls and DDL, flush the whole cache.
+ */
+
+void odbc_cache_invalidate( ODBCDatabase *db, const char *query, int query_length )
+{
+	int length;
+	char name[ 131 ];
+	ODBCCacheEntry *entry, *next;
+
+	if ( !odbc_cache_used && odbc_shared == NULL )
+	{
+		return;
+	}
+
+	if ( !odbc_cache_target( query, query_length, &name[ 1 ], sizeof( name ) - 2 ) )
+	{
+		odbc_log( db, "--- Result cache flushed, the statement's target table is unknown\n" );
+		odbc_shared_written( NULL );
+		odbc_cache_flush();
+
+		db->cache_written_all = 1;
+		return;
+	}
+
+	odbc_shared_written( &name[ 1 ] );
+
+	name[ 0 ] = '|';
+	strcat( name, "|" );
+
+	/* Remembered until the write commits, appended over the trailing separator of the list */
+
+	length = ( int ) strlen( db->cache_written );
+
+	if ( !db->cache_written_all && strstr( db->cache_written, name ) == NULL )
+	{
+		if ( length + strlen( name ) < sizeof( db->cache_written ) )	strcpy( &db->cache_written[ length ? length - 1 : 0 ], name );
+		else															db->cache_written_all = 1;
+	}
+
+	EnterCriticalSection( &odbc_cache_lock );
+
+	for ( entry = odbc_cache_first; entry; entry = next )
+	{
+		next = entry->next;
+
+		/* Entries with shared tags are checked against the generations when next looked up */
+
+		if ( entry->tables ? strstr( entry->tables, name ) != NULL : !entry->tags.valid )
+		{
+			odbc_cache_unlink( entry );
+			odbc_cache_invalidations++;
+		}
+	}
+
+	LeaveCriticalSection( &odbc_cache_lock );
+}
+
+/*
+ * odbc_skip_rows
+ *
+ * Discards up to count rows of a forward-only cursor.  The columns are unbound and the rows are
+ * fetched in large rowsets, so nothing is copied out of the driver.  Forward-only cursors cannot
+ * use SQL_FETCH_RELATIVE, so this is the cheapest way to move the cursor.  Views with a row store
+ * are not skipped, since the store must hold every row for backward navigation.
+ */
+
+int odbc_skip_rows( ODBCDatabaseView *view, int count, int *skipped )
+{
+	int ok, size;
+	UDWORD cRow;
+	SQLULEN fetched;
+	SQLRETURN retcode;
+	SQLUSMALLINT status[ ODBC_SKIP_ROWSET ];
+
+	ok			= 1;
+	*skipped	= 0;
+
+	if ( SQLFreeStmt( view->hSTMT, SQL_UNBIND ) == SQL_ERROR )	return odbc_error( view->db, "SQLFreeStmt: ", view->hSTMT, SQL_HANDLE_STMT );
+
+	if ( view->rowset_size > 1 )
+	{
+		if ( ( SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROW_STATUS_PTR,	status,		0 ) == SQL_ERROR ) ||
+			 ( SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROWS_FETCHED_PTR,	&fetched,	0 ) == SQL_ERROR ) )
+		{
+			ok = odbc_error( view->db, "SQLSetStmtAttr: ", view->hSTMT, SQL_HANDLE_STMT );
+		}
+	}
+
+	while ( ok && ( *skipped < count ) )
+	{
+		size	= ( count - *skipped < ODBC_SKIP_ROWSET ) ? count - *skipped : ODBC_SKIP_ROWSET;
+		fetched	= 0;
+
+		if ( view->rowset_size > 1 )
+		{
+			if ( SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROW_ARRAY_SIZE, ( SQLPOINTER ) ( SQLULEN ) size, 0 ) == SQL_ERROR )
+			{
+				ok = odbc_error( view->db, "SQLSetStmtAttr: ", view->hSTMT, SQL_HANDLE_STMT );
+				break;
+			}
+
+			if ( ( retcode = SQLFetchScroll( view->hSTMT, SQL_FETCH_NEXT, 0 ) ) == SQL_ERROR )
+			{
+				ok = odbc_error( view->db, "SQLFetchScroll: ", view->hSTMT, SQL_HANDLE_STMT );
+				break;
+			}
+		}
+		else
+		{
+			if ( SQLSetStmtOption( view->hSTMT, SQL_ROWSET_SIZE, size ) == SQL_ERROR )
+			{
+				ok = odbc_error( view->db, "SQLSetStmtOption: ", view->hSTMT, SQL_HANDLE_STMT );
+				break;
+			}
+
+			if ( ( retcode = SQLExtendedFetch( view->hSTMT, SQL_FETCH_NEXT, 0, &cRow, status ) ) == SQL_ERROR )
+			{
+				ok = odbc_error( view->db, "SQLExtendedFetch: ", view->hSTMT, SQL_HANDLE_STMT );
+				break;
+			}
+
+			fetched = cRow;
+		}
+
+		if ( retcode == SQL_NO_DATA_FOUND || fetched == 0 )
+		{
+			view->eof->data_integer = 1;
+			break;
+		}
+
+		*skipped += ( int ) fetched;
+	}
+
+	/*
+	 * Restore the rowset size and bindings for the target row
+	 */
+
+	if ( view->rowset_size > 1 )
+	{
+		/* status and fetched go out of scope, and odbc_bind_rowset does not set them again if it falls back to single row fetch */
+
+		SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROW_STATUS_PTR,	NULL,	0 );
+		SQLSetStmtAttr( view->hSTMT, SQL_ATTR_ROWS_FETCHED_PTR,	NULL,	0 );
+
+		if ( !odbc_bind_rowset( view ) )																	ok = 0;
+	}
+
+	if ( view->rowset_size == 1 && SQLSetStmtOption( view->hSTMT, SQL_ROWSET_SIZE, 1 ) == SQL_ERROR )
+	{
+		ok = odbc_error( view->db, "SQLSetStmtOption: ", view->hSTMT, SQL_HANDLE_STMT );
+	}
+
+	if ( !odbc_bind_buffers( view ) )																		ok = 0;
+
+	odbc_log( view->db, "--- Skipped %d of %d rows unbound, eof = %d\n", *skipped, count, view->eof->data_integer );
+
+	return ok;
+}
+
+/*
+ * odbc_load_rowset
+ *
+ * Serves rows from the block cursor buffers, fetching the next rowset only when the requested row
+ * falls outside of the buffered one.
+ */
+
+int odbc_load_rowset( ODBCDatabaseView *view, int row )
+{
+	int skipped;
+	SQLRETURN retcode;
+	LONGLONG start;
+
+	if ( view->forwardonly )
+	{
+		if ( row < view->rowset_first )
+		{
+			return 1;
+		}
+
+		while ( ( view->eof->data_integer == 0 ) && ( row >= view->rowset_first + ( int ) view->rowset_count ) )
+		{
+			if ( ( view->db->fast_skip > 0 ) && ( view->store == NULL ) && ( view->prefetch_thread == NULL ) && ( row - view->rowset_next >= view->db->fast_skip ) )
+			{
+				if ( !odbc_skip_rows( view, row - view->rowset_next, &skipped ) )	return 0;
+
+				view->rowset_next			+= skipped;
+				view->rowset_first			= view->rowset_next;
+				view->rowset_count			= 0;
+
+				if ( view->eof->data_integer )
+				{
+					view->recno->data_integer	= view->rowset_first;
+					break;
+				}
+			}
+
+			if ( view->store && !odbc_store_settle( view ) )	return 0;
+
+			start				= odbc_timer();
+			retcode				= odbc_fetch_next( view );
+			odbc_stats_record( view->db, ODBC_PHASE_FETCH, start );
+
+			if ( retcode == SQL_ERROR )	return odbc_error( view->db, "SQLFetchScroll: ", view->hSTMT, SQL_HANDLE_STMT );
+
+			view->rowset_first	= view->rowset_next;
+
+			if ( retcode == SQL_NO_DATA_FOUND || view->rowset_count == 0 )
+			{
+				view->rowset_count			= 0;
+				view->recno->data_integer	= view->rowset_first;
+				view->eof->data_integer		= 1;
+			}
+			else
+			{
+				odbc_stats_fetched( view, ( int ) view->rowset_count );
+
+				if ( view->store && !odbc_store_rowset( view, ( int ) view->rowset_count ) )	return 0;
+			}
+
+			view->rowset_next	+= ( int ) view->rowset_count;
+		}
+	}
+	else if ( ( view->rowset_first == 0 ) || ( row < view->rowset_first ) || ( row >= view->rowset_first + ( int ) view->rowset_count ) )
+	{
+		view->rowset_count	= 0;
+		start				= odbc_timer();
+		retcode				= SQLFetchScroll( view->hSTMT, SQL_FETCH_ABSOLUTE, row );
+		odbc_stats_record( view->db, ODBC_PHASE_FETCH, start );
+
+		if ( retcode == SQL_ERROR )	return odbc_error( view->db, "SQLFetchScroll: ", view->hSTMT, SQL_HANDLE_STMT );
+
+		if ( retcode == SQL_NO_DATA_FOUND || view->rowset_count == 0 )
+		{
+			view->rowset_first			= 0;
+			view->rowset_count			= 0;
+			view->eof->data_integer		= 1;
+
+			return 1;
+		}
+
+		view->rowset_first	= row;
+		odbc_stats_fetched( view, ( int ) view->rowset_count );
+	}
+
+	if ( view->eof->data_integer == 0 || row < view->rowset_first + ( int ) view->rowset_count )
+	{
+		view->recno->data_integer	= row;
+		view->eof->data_integer		= 0;
+
+		odbc_select_row( view, row - view->rowset_first );
+	}
+
+	return 1;
+}
+
+/*
+ * odbc_load_row
+ */
+
+int odbc_load_row( ODBCDatabaseView *view, int row )
+{
+	int skipped;
+	UDWORD cRow;
+	UWORD rgfStatus;
+	SQLRETURN retcode;
+	LONGLONG start;
+
+	if ( view->store && ( row < view->store->next_row || view->store->complete ) )
+	{
+		if ( !odbc_store_load( view, row ) )	return 0;
+
+		odbc_log( view->db, "*** odbc_load_row( %d ) from row store, eof = %d\n", row, view->eof->data_integer );
+		return 1;
+	}
+	else if ( view->store )
+	{
+		/* Resume from the cursor position, which is the last row stored */
+
+		view->recno->data_integer	= view->store->next_row - 1;
+		view->eof->data_integer		= 0;
+	}
+
+	if ( view->rowset_size > 1 )
+	{
+		if ( !odbc_load_rowset( view, row ) )	return 0;
+	}
+	else if ( view->forwardonly )
+	{
+		if ( ( view->db->fast_skip > 0 ) && ( view->store == NULL ) && ( view->eof->data_integer == 0 ) && ( row - view->recno->data_integer - 1 >= view->db->fast_skip ) )
+		{
+			if ( !odbc_skip_rows( view, row - view->recno->data_integer - 1, &skipped ) )	return 0;
+
+			view->recno->data_integer += skipped;
+		}
+
+		while ( ( view->eof->data_integer == 0 ) && ( view->recno->data_integer < row ) )
+		{
+			if ( view->store && !odbc_store_settle( view ) )	return 0;
+
+			view->recno->data_integer++;
+
+			start	= odbc_timer();
+			retcode	= SQLExtendedFetch( view->hSTMT, SQL_FETCH_NEXT, row - view->recno->data_integer, &cRow, &rgfStatus );
+			odbc_stats_record( view->db, ODBC_PHASE_FETCH, start );
+
+			switch ( retcode ) 
+			{
+				case SQL_ERROR			: return odbc_error( view->db, "SQLExtendedFetch: ", view->hSTMT, SQL_HANDLE_STMT );
+				case SQL_NO_DATA_FOUND	: view->eof->data_integer = 1;	break;
+				default					:
+				{
+					view->rowset_status[ 0 ] = rgfStatus;
+					odbc_stats_fetched( view, 1 );
+
+					if ( view->store && !odbc_store_rowset( view, 1 ) )	return 0;
+					break;
+				}
+			}
+		}
+
+		odbc_select_row( view, 0 );
+	}
+	else
+	{
+		start	= odbc_timer();
+		retcode	= SQLExtendedFetch( view->hSTMT, SQL_FETCH_ABSOLUTE, row, &cRow, &rgfStatus );
+		odbc_stats_record( view->db, ODBC_PHASE_FETCH, start );
+
+		switch ( retcode ) 
+		{
+			case SQL_ERROR			: return odbc_error( view->db, "SQLExtendedFetch: ", view->hSTMT, SQL_HANDLE_STMT );
+			case SQL_NO_DATA_FOUND	: view->eof->data_integer = 1;		break;
+			default					: view->recno->data_integer = row;	view->rowset_status[ 0 ] = rgfStatus;	odbc_stats_fetched( view, 1 );	break;
+		}
+
+		odbc_select_row( view, 0 );
+	}
+
+	if ( view->store )
+	{
+		/*
+		 * The current row is always served from the store.  Values that overflowed their buffers
+		 * and were stored unread are read from the cursor, which is still on the row.
+		 */
+
+		if ( view->eof->data_integer )
+		{
+			view->store->complete = 1;
+
+			if ( view->cache_key )	odbc_cache_insert( view );
+		}
+		else if ( !odbc_store_load( view, view->recno->data_integer ) )
+		{
+			return 0;
+		}
+	}
+
+	odbc_log( view->db, "*** odbc_load_row( %d ), eof = %d, deleted = %d\n",
+			  row,
+			  view->eof->data_integer,
+			  view->deleted->data_integer );
+
+	return 1;
+}
+
+/*
+ * Connection pool
+ *
+ * Connections are shared by every worker thread in the process, so the idle list and the pool
+ * settings are only accessed under odbc_pool_lock.  Connecting, validating and disconnecting are
+ * done outside of the lock.
+ */
+
+static CRITICAL_SECTION		odbc_pool_lock;
+static SQLHENV				odbc_pool_hEnv			= SQL_NULL_HENV;
+static ODBCPoolConnection	*odbc_pool_idle			= NULL;
+static int					odbc_pool_idle_count	= 0;
+static int					odbc_pool_size			= 8;		/* Maximum idle connections, 0 disables pooling */
+static int					odbc_pool_idle_timeout	= 60;		/* Seconds */
+static int					odbc_pool_lifetime		= 600;		/* Seconds */
+static LONG					odbc_pool_prewarmed		= 0;
+
+/*
+ * odbc_pool_setting
+ */
+
+int odbc_pool_setting( const char *name, int default_value )
+{
+	char buffer[ 32 ];
+	DWORD length;
+
+	length = GetEnvironmentVariable( name, buffer, sizeof( buffer ) );
+	if ( length == 0 || length >= sizeof( buffer ) )	return default_value;
+
+	return odbc_parameter_integer( buffer, length );
+}
+
+/*
+ * odbc_pool_environment
+ *
+ * Returns the process-wide environment handle, allocating it on first use
+ */
+
+int odbc_pool_environment( ODBCDatabase *db )
+{
+	EnterCriticalSection( &odbc_pool_lock );
+
+	if ( odbc_pool_hEnv == SQL_NULL_HENV && SQLAllocEnv( &odbc_pool_hEnv ) == SQL_ERROR )
+	{
+		odbc_pool_hEnv = SQL_NULL_HENV;
+	}
+
+	db->hEnv = odbc_pool_hEnv;
+
+	LeaveCriticalSection( &odbc_pool_lock );
+
+	if ( db->hEnv == SQL_NULL_HENV )	return odbc_error( db, "SQLAllocEnv: ", NULL, 0 );
+	return 1;
+}
+
+/*
+ * odbc_pool_key
+ */
+
+char *odbc_pool_key( const char *path, int path_length, const char *user, int user_length, const char *password, int password_length, int *key_length )
+{
+	char *key;
+
+	*key_length	= path_length + 1 + user_length + 1 + password_length;
+	key			= ( char * ) mvProgram_Allocate( NULL, *key_length + 1 );
+
+	memcpy( key, path, path_length );
+	key[ path_length ] = '\0';
+
+	memcpy( &key[ path_length + 1 ], user, user_length );
+	key[ path_length + 1 + user_length ] = '\0';
+
+	memcpy( &key[ path_length + 1 + user_length + 1 ], password, password_length );
+	key[ *key_length ] = '\0';
+
+	return key;
+}
+
+/*
+ * odbc_pool_discard
+ */
+
+void odbc_pool_discard( ODBCPoolConnection *connection )
+{
+	if ( connection->hDBC )
+	{
+		SQLDisconnect( connection->hDBC );
+		SQLFreeConnect( connection->hDBC );
+	}
+
+	mvProgram_Free( NULL, connection->key );
+	mvProgram_Free( NULL, connection );
+}
+
+/*
+ * odbc_pool_connect
+ *
+ * Opens a new connection for the key with SQLDriverConnect if the path is a connection string,
+ * or SQLConnect if it is a DSN.
+ */
+
+ODBCPoolConnection *odbc_pool_connect( ODBCDatabase *db, const char *key, int key_length )
+{
+	int i, driverconnect;
+	const char *path, *user, *password;
+	int path_length, user_length, password_length;
+	UCHAR szConnStrOut[ 255 ];
+	SWORD cbConnStrOut;
+	ODBCPoolConnection *connection;
+
+	path				= key;
+	path_length			= strlen( path );
+	user				= &path[ path_length + 1 ];
+	user_length			= strlen( user );
+	password			= &user[ user_length + 1 ];
+	password_length		= key_length - ( path_length + 1 + user_length + 1 );
+
+	connection			= ( ODBCPoolConnection * ) odbc_allocate( db, sizeof( ODBCPoolConnection ) );
+	memset( connection, 0, sizeof( ODBCPoolConnection ) );
+
+	connection->key			= ( char * ) odbc_allocate( db, key_length + 1 );
+	connection->key_length	= key_length;
+	connection->created		= GetTickCount64();
+
+	memcpy( connection->key, key, key_length + 1 );
+
+	if ( SQLAllocConnect( db->hEnv, &( connection->hDBC ) ) == SQL_ERROR )
+	{
+		odbc_error( db, "SQLAllocConnect: ", db->hEnv, SQL_HANDLE_ENV );
+		
+		connection->hDBC = SQL_NULL_HDBC;
+		goto error;
+	}
+
+	if ( SQLSetConnectAttr( connection->hDBC, SQL_ATTR_AUTOCOMMIT, SQL_AUTOCOMMIT_OFF, 0 ) != SQL_SUCCESS )
+	{
+		odbc_error( db, "SQLSetConnectAttr: ", connection->hDBC, SQL_HANDLE_DBC );
+		goto error;
+	}
+
+	driverconnect = 0;
+
+	for ( i = 0; i < path_length; i++ )
+	{
+		if ( path[ i ] == '=' )
+		{
+			driverconnect = 1;
+			break;
+		}
+	}
+
+	if ( driverconnect )
+	{
+		cbConnStrOut = sizeof( szConnStrOut );
+		if ( SQLDriverConnect( connection->hDBC, NULL, ( UCHAR * ) path, ( SWORD ) path_length, 
+							   szConnStrOut, sizeof( szConnStrOut ), &cbConnStrOut, 
+							   SQL_DRIVER_NOPROMPT ) == SQL_ERROR )
+		{
+			odbc_error( db, "SQLDriverConnect: ", connection->hDBC, SQL_HANDLE_DBC );
+			goto error;
+		}
+	}
+	else
+	{
+		if ( SQLConnect( connection->hDBC, ( UCHAR * ) path, ( SWORD ) path_length,
+						 ( UCHAR * ) user, ( SWORD ) user_length,
+						 ( UCHAR * ) password, ( SWORD ) password_length ) == SQL_ERROR )
+		{
+			odbc_error( db, "SQLConnect: ", connection->hDBC, SQL_HANDLE_DBC );
+			goto error;
+		}
+	}
+
+	return connection;
+
+error:
+
+	if ( connection->hDBC )
+	{
+		SQLFreeConnect( connection->hDBC );
+		connection->hDBC = SQL_NULL_HDBC;
+	}
+
+	odbc_pool_discard( connection );
+	return NULL;
+}
+
+/*
+ * odbc_pool_sweep
+ *
+ * Removes idle connections that have exceeded the idle timeout or their maximum lifetime, and any
+ * beyond the pool size.  Must be called with odbc_pool_lock held; the removed connections are
+ * returned so that they can be disconnected after the lock is released.
+ */
+
+ODBCPoolConnection *odbc_pool_sweep( ULONGLONG now )
+{
+	int count;
+	ODBCPoolConnection *connection, **link, *expired;
+
+	expired	= NULL;
+	count	= 0;
+	link	= &odbc_pool_idle;
+
+	while ( ( connection = *link ) != NULL )
+	{
+		if ( ( count >= odbc_pool_size ) ||
+			 ( now - connection->released >= ( ULONGLONG ) odbc_pool_idle_timeout * 1000 ) ||
+			 ( now - connection->created >= ( ULONGLONG ) odbc_pool_lifetime * 1000 ) )
+		{
+			*link				= connection->next;
+			connection->next	= expired;
+			expired				= connection;
+
+			odbc_pool_idle_count--;
+		}
+		else
+		{
+			link				= &connection->next;
+			count++;
+		}
+	}
+
+	return expired;
+}
+
+/*
+ * odbc_pool_discard_list
+ */
+
+void odbc_pool_discard_list( ODBCPoolConnection *connection )
+{
+	ODBCPoolConnection *next;
+
+	for ( ; connection; connection = next )
+	{
+		next = connection->next;
+		odbc_pool_discard( connection );
+	}
+}
+
+/*
+ * odbc_pool_checkout
+ *
+ * Returns an idle connection for the key if one is available and still usable, otherwise opens a
+ * new one.  Reused connections are rolled back and returned to manual commit.
+ */
+
+ODBCPoolConnection *odbc_pool_checkout( ODBCDatabase *db, const char *key, int key_length )
+{
+	SQLUINTEGER dead;
+	ODBCPoolConnection *connection, **link, *expired;
+
+	while ( 1 )
+	{
+		EnterCriticalSection( &odbc_pool_lock );
+
+		expired = odbc_pool_sweep( GetTickCount64() );
+
+		for ( link = &odbc_pool_idle; ( connection = *link ) != NULL; link = &connection->next )
+		{
+			if ( connection->key_length == key_length && !memcmp( connection->key, key, key_length ) )
+			{
+				*link				= connection->next;
+				connection->next	= NULL;
+
+				odbc_pool_idle_count--;
+				break;
+			}
+		}
+
+		LeaveCriticalSection( &odbc_pool_lock );
+
+		odbc_pool_discard_list( expired );
+
+		if ( connection == NULL )
+		{
+			return odbc_pool_connect( db, key, key_length );
+		}
+
+		dead = SQL_CD_FALSE;
+
+		if ( ( SQLGetConnectAttr( connection->hDBC, SQL_ATTR_CONNECTION_DEAD, &dead, 0, NULL ) == SQL_SUCCESS && dead == SQL_CD_TRUE ) ||
+			 ( SQLEndTran( SQL_HANDLE_DBC, connection->hDBC, SQL_ROLLBACK ) == SQL_ERROR ) ||
+			 ( SQLSetConnectAttr( connection->hDBC, SQL_ATTR_AUTOCOMMIT, SQL_AUTOCOMMIT_OFF, 0 ) == SQL_ERROR ) )
+		{
+			odbc_log( db, "+++ Discarding unusable pooled connection\n" );
+			odbc_pool_discard( connection );
+
+			continue;
+		}
+
+		odbc_log( db, "--- Reusing pooled connection\n" );
+		return connection;
+	}
+}
+
+/*
+ * odbc_pool_checkin
+ *
+ * Returns a connection to the idle list, or disconnects it if pooling is disabled, the connection
+ * is not reusable or it has exceeded its maximum lifetime.
+ */
+
+void odbc_pool_checkin( ODBCPoolConnection *connection, int reusable )
+{
+	ULONGLONG now;
+	ODBCPoolConnection *expired;
+
+	now = GetTickCount64();
+
+	if ( ( reusable ) &&
+		 ( SQLEndTran( SQL_HANDLE_DBC, connection->hDBC, SQL_ROLLBACK ) != SQL_ERROR ) &&
+		 ( SQLSetConnectAttr( connection->hDBC, SQL_ATTR_AUTOCOMMIT, SQL_AUTOCOMMIT_OFF, 0 ) != SQL_ERROR ) )
+	{
+		EnterCriticalSection( &odbc_pool_lock );
+
+		connection->released	= now;
+		connection->next		= odbc_pool_idle;
+		odbc_pool_idle			= connection;
+		odbc_pool_idle_count++;
+
+		expired					= odbc_pool_sweep( now );
+
+		LeaveCriticalSection( &odbc_pool_lock );
+
+		odbc_pool_discard_list( expired );
+		return;
+	}
+
+	odbc_pool_discard( connection );
+}
+
+/*
+ * odbc_pool_prewarm
+ *
+ * Opens the connections listed in MVDODBC_POOL_PREWARM, formatted as "count|path|user|password",
+ * and places them in the idle list.
+ */
+
+void odbc_pool_prewarm( void )
+{
+	int i, count, key_length, field_length[ 4 ];
+	const char *field[ 4 ];
+	char buffer[ 1024 ], *separator, *key;
+	DWORD length;
+	ODBCDatabase dbcontext;
+	ODBCPoolConnection *connection;
+
+	length = GetEnvironmentVariable( "MVDODBC_POOL_PREWARM", buffer, sizeof( buffer ) );
+	if ( length == 0 || length >= sizeof( buffer ) )	return;
+
+	field[ 0 ] = buffer;
+
+	for ( i = 0; i < 3; i++ )
+	{
+		if ( ( separator = strchr( field[ i ], '|' ) ) == NULL )	return;
+
+		field_length[ i ]	= separator - field[ i ];
+		field[ i + 1 ]		= separator + 1;
+	}
+
+	field_length[ 3 ]	= ( buffer + length ) - field[ 3 ];
+	count				= odbc_parameter_integer( field[ 0 ], field_length[ 0 ] );
+
+	memset( &dbcontext, 0, sizeof( dbcontext ) );
+	if ( !odbc_pool_environment( &dbcontext ) )	return;
+
+	key = odbc_pool_key( field[ 1 ], field_length[ 1 ], field[ 2 ], field_length[ 2 ], field[ 3 ], field_length[ 3 ], &key_length );
+
+	for ( i = 0; i < count && i < odbc_pool_size; i++ )
+	{
+		if ( ( connection = odbc_pool_connect( &dbcontext, key, key_length ) ) == NULL )
+		{
+			break;
+		}
+
+		odbc_pool_checkin( connection, 1 );
+	}
+
+	mvProgram_Free( NULL, key );
+}
+
+/*
+ * odbc_db_open
+ */
+
+int	odbc_db_open( mvDatabase db,
+				  const char *path,		int path_length,
+				  const char *name,		int name_path,
+				  const char *user,		int user_length, 
+				  const char *password,	int password_length ,
+				  const char *flags,	int flags_length )
+{
+	int key_length;
+	char *key;
+	ODBCDatabase *dbcontext;
+
+	dbcontext = ( ODBCDatabase *) mvProgram_Allocate( NULL, sizeof( ODBCDatabase ) );
+	memset( dbcontext, 0, sizeof( ODBCDatabase ) );
+	mvDatabase_SetData( db, dbcontext );
+
+	if ( !odbc_pool_environment( dbcontext ) )	return 0;
+
+	key						= odbc_pool_key( path, path_length, user, user_length, password, password_length, &key_length );
+	dbcontext->connection	= odbc_pool_checkout( dbcontext, key, key_length );
+
+	mvProgram_Free( NULL, key );
+
+	if ( dbcontext->connection == NULL )		return 0;
+
+	dbcontext->hDBC				= dbcontext->connection->hDBC;
+	dbcontext->autocommit		= 1;
+	dbcontext->stmt_direct		= 1;
+	dbcontext->firehose_store	= 64 * 1024 * 1024;
+	dbcontext->fast_skip		= 1000;
+	dbcontext->param_cache_size	= 128;
+	dbcontext->shape_cache_size	= 64;
+	dbcontext->inline_blob		= 8192;
+	dbcontext->blob_max			= 16 * 1024 * 1024;
+	dbcontext->string_max		= 4096;
+	dbcontext->string_learn		= 1;
+	dbcontext->replica_sticky	= 1000;
+
+	return 1;
+}
+
+/*
+ * odbc_replica_add
+ *
+ * Adds a read replica DSN or connection string, using the primary's user and password
+ */
+
+int odbc_replica_add( ODBCDatabase *db, const char *path, int path_length )
+{
+	const char *user, *password;
+	int user_length, password_length;
+	ODBCReplica *replica, **link;
+
+	if ( db->connection == NULL )
+	{
+		strcpy( db->error, "Read replicas require a pooled connection" );
+		return 0;
+	}
+
+	user					= &db->connection->key[ strlen( db->connection->key ) + 1 ];
+	user_length				= strlen( user );
+	password				= &user[ user_length + 1 ];
+	password_length			= db->connection->key_length - ( int ) ( password - db->connection->key );
+
+	replica					= ( ODBCReplica * ) odbc_allocate( db, sizeof( ODBCReplica ) );
+	memset( replica, 0, sizeof( ODBCReplica ) );
+
+	replica->key			= odbc_pool_key( path, path_length, user, user_length, password, password_length, &replica->key_length );
+
+	for ( link = &db->replicas; *link; link = &( *link )->next );
+
+	*link					= replica;
+	db->replica_count++;
+	db->replica_routing		= 1;
+
+	odbc_log( db, "--- Read replica added: %s\n", replica->key );
+	return 1;
+}
+
+/*
+ * odbc_select_writes
+ *
+ * Returns 1 if a SELECT statement writes or locks rows, as SELECT ... INTO and SELECT ... FOR UPDATE
+ * do, judging by its words outside of string literals, quoted identifiers and comments
+ */
+
+int odbc_select_writes( const char *query, int query_length )
+{
+	int i, length;
+	char quote;
+
+	for ( i = 0; i < query_length; i++ )
+	{
+		switch ( query[ i ] )
+		{
+			case '\''	:
+			case '"'	:
+			case '['	:
+			case '`'	:
+			{
+				quote = ( query[ i ] == '[' ) ? ']' : query[ i ];
+
+				for ( i++; i < query_length && query[ i ] != quote; i++ );
+				break;
+			}
+			case '-'	:
+			{
+				if ( i + 1 < query_length && query[ i + 1 ] == '-' )
+				{
+					for ( i += 2; i < query_length && query[ i ] != '\n'; i++ );
+				}
+
+				break;
+			}
+			case '/'	:
+			{
+				if ( i + 1 < query_length && query[ i + 1 ] == '*' )
+				{
+					for ( i += 2; i + 1 < query_length && ( query[ i ] != '*' || query[ i + 1 ] != '/' ); i++ );
+					i++;
+				}
+
+				break;
+			}
+			default		:
+			{
+				if ( i > 0 && ODBC_WORD_CHAR( query[ i - 1 ] ) )
+				{
+					break;
+				}
+
+				if ( odbc_word( &query[ i ], query_length - i, "into" ) )
+				{
+					return 1;
+				}
+
+				if ( ( length = odbc_word( &query[ i ], query_length - i, "for" ) ) != 0 &&
+					 ( odbc_word( &query[ i + length ], query_length - i - length, "update" ) || odbc_word( &query[ i + length ], query_length - i - length, "share" ) ) )
+				{
+					return 1;
+				}
+
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * odbc_replica_route
+ *
+ * Chooses the replica for a view, or returns NULL if the view must run on the primary.  Only
+ * SELECT statements outside of transactions qualify, and only once the primary's writes from the
+ * last replica_sticky milliseconds, queued write-behind statements and pending group commits have
+ * settled.  The replica with the fewest open views is chosen, ties are broken round-robin.  When
+ * connect is set the replica's own connection is opened if needed.
+ */
+
+ODBCReplica *odbc_replica_route( ODBCDatabase *db, const char *query, int query_length, int connect )
+{
+	int i;
+	ULONGLONG now;
+	ODBCReplica *replica, *best;
+
+	if ( !db->replica_routing || !db->autocommit || db->in_transaction || db->group_pending )
+	{
+		return NULL;
+	}
+
+	if ( db->writebehind && db->writebehind->completed != db->writebehind->submitted )
+	{
+		return NULL;
+	}
+
+	now = GetTickCount64();
+
+	if ( now - db->last_write < ( ULONGLONG ) db->replica_sticky || !odbc_keyword( query, query_length, "select" ) || odbc_select_writes( query, query_length ) )
+	{
+		return NULL;
+	}
+
+	replica = db->replica_next ? db->replica_next : db->replicas;
+
+	for ( i = 0, best = NULL; i < db->replica_count; i++ )
+	{
+		if ( replica->retry <= now && ( best == NULL || replica->outstanding < best->outstanding ) )
+		{
+			best = replica;
+		}
+
+		replica = replica->next ? replica->next : db->replicas;
+	}
+
+	if ( best == NULL )
+	{
+		return NULL;
+	}
+
+	db->replica_next = best->next;
+
+	if ( connect && best->connection == NULL && ( best->connection = odbc_pool_checkout( db, best->key, best->key_length ) ) == NULL )
+	{
+		odbc_log( db, "+++ Read replica %s is unavailable, using the primary: %s\n", best->key, db->error );
+
+		best->retry		= now + 30000;
+		db->error[ 0 ]	= '\0';
+
+		return NULL;
+	}
+
+	best->outstanding++;
+	best->views++;
+
+	return best;
+}
+
+/*
+ * odbc_replica_release
+ *
+ * Called when a view routed to the replica closes.  The replica connection does not autocommit,
+ * so the read transaction is ended once no views remain open on it.
+ */
+
+void odbc_replica_release( ODBCReplica *replica )
+{
+	if ( --replica->outstanding == 0 && replica->connection )
+	{
+		SQLEndTran( SQL_HANDLE_DBC, replica->connection->hDBC, SQL_COMMIT );
+	}
+}
+
+/*
+ * odbc_replica_free
+ */
+
+void odbc_replica_free( ODBCDatabase *db )
+{
+	ODBCReplica *replica, *next;
+
+	for ( replica = db->replicas; replica; replica = next )
+	{
+		next = replica->next;
+
+		if ( replica->connection )	odbc_pool_checkin( replica->connection, !db->nopool );
+
+		odbc_log( db, "*** Read replica %s: views = %u\n", replica->key, replica->views );
+
+		mvProgram_Free( NULL, replica->key );
+		mvProgram_Free( NULL, replica );
+	}
+
+	db->replicas		= NULL;
+	db->replica_next	= NULL;
+	db->replica_count	= 0;
+}
+
+/*
+ * odbc_writebehind_failed
+ *
+ * Records a failure for the script's thread to log, since the worker must not touch the database
+ * context.
+ */
+
+void odbc_writebehind_failed( ODBCWriteBehind *wb, SQLSMALLINT handle_type, SQLHANDLE handle, const char *prefix, ODBCWriteEntry *entry )
+{
+	SQLINTEGER native;
+	SQLSMALLINT text_length;
+	char state[ 6 ], text[ 400 ];
+
+	if ( SQLGetDiagRec( handle_type, handle, 1, state, &native, text, sizeof( text ), &text_length ) != SQL_SUCCESS )
+	{
+		strcpy( ( char * ) state, "?????" );
+		strcpy( text, "Unknown error" );
+	}
+
+	EnterCriticalSection( &wb->lock );
+	sprintf( wb->last_error, "%s%s: %.400s [%.*s]", prefix, state, text, entry->query_length > 80 ? 80 : entry->query_length, entry->query );
+	LeaveCriticalSection( &wb->lock );
+
+	InterlockedIncrement( &wb->failures );
+}
+
+/*
+ * odbc_writebehind_execute
+ *
+ * Runs one queued statement on the worker's connection.  Returns 0 and records the failure if the
+ * statement fails.
+ */
+
+int odbc_writebehind_execute( ODBCWriteBehind *wb, ODBCWriteEntry *entry )
+{
+	int i;
+	SQLRETURN retcode;
+
+	SQLFreeStmt( wb->hSTMT, SQL_CLOSE );
+	SQLFreeStmt( wb->hSTMT, SQL_RESET_PARAMS );
+
+	for ( i = 0, retcode = SQL_SUCCESS; i < entry->param_count && retcode != SQL_ERROR; i++ )
+	{
+		entry->indicators[ i ]	= entry->lengths[ i ];
+		retcode					= SQLBindParameter( wb->hSTMT, ( SQLUSMALLINT ) ( i + 1 ), SQL_PARAM_INPUT, SQL_C_CHAR,
+													( entry->lengths[ i ] > 4000 ) ? SQL_LONGVARCHAR : SQL_VARCHAR,
+													entry->lengths[ i ] ? entry->lengths[ i ] : 1, 0,
+													entry->values[ i ], entry->lengths[ i ], &entry->indicators[ i ] );
+	}
+
+	if ( retcode != SQL_ERROR )
+	{
+		retcode = SQLExecDirect( wb->hSTMT, ( SQLCHAR * ) entry->query, entry->query_length );
+	}
+
+	if ( retcode != SQL_ERROR )
+	{
+		return 1;
+	}
+
+	odbc_writebehind_failed( wb, SQL_HANDLE_STMT, wb->hSTMT, "", entry );
+
+	return 0;
+}
+
+/*
+ * odbc_writebehind_committed
+ *
+ * Advances the generation of the table written by a committed statement, see odbc_cache_committed
+ */
+
+void odbc_writebehind_committed( ODBCWriteEntry *entry )
+{
+	char name[ 129 ];
+
+	if ( !odbc_cache_used && odbc_shared == NULL )
+	{
+		return;
+	}
+
+	odbc_generations_committed( odbc_cache_target( entry->query, entry->query_length, name, sizeof( name ) ) ? name : NULL );
+}
+
+/*
+ * odbc_writebehind_commit
+ *
+ * Commits a group of executed statements and frees them.  If one of them failed, or the commit
+ * itself fails, the group is rolled back and its other statements are run again one per
+ * transaction: some drivers (PostgreSQL) abort the whole transaction on the first error, and a
+ * failed commit loses every statement of the group.
+ */
+
+void odbc_writebehind_commit( ODBCWriteBehind *wb, ODBCWriteEntry **group, int *failed, int count, int group_failed )
+{
+	int i;
+	SQLHDBC hDBC;
+
+	hDBC = wb->connection->hDBC;
+
+	if ( group_failed || SQLEndTran( SQL_HANDLE_DBC, hDBC, SQL_COMMIT ) == SQL_ERROR )
+	{
+		SQLEndTran( SQL_HANDLE_DBC, hDBC, SQL_ROLLBACK );
+
+		for ( i = 0; i < count; i++ )
+		{
+			if ( failed[ i ] )
+			{
+				continue;
+			}
+
+			if ( !odbc_writebehind_execute( wb, group[ i ] ) )
+			{
+				SQLEndTran( SQL_HANDLE_DBC, hDBC, SQL_ROLLBACK );
+			}
+			else if ( SQLEndTran( SQL_HANDLE_DBC, hDBC, SQL_COMMIT ) == SQL_ERROR )
+			{
+				odbc_writebehind_failed( wb, SQL_HANDLE_DBC, hDBC, "COMMIT ", group[ i ] );
+				SQLEndTran( SQL_HANDLE_DBC, hDBC, SQL_ROLLBACK );
+			}
+			else
+			{
+				odbc_writebehind_committed( group[ i ] );
+			}
+		}
+	}
+	else
+	{
+		for ( i = 0; i < count; i++ )
+		{
+			if ( !failed[ i ] )	odbc_writebehind_committed( group[ i ] );
+		}
+	}
+
+	for ( i = 0; i < count; i++ )
+	{
+		mvProgram_Free( NULL, group[ i ] );
+	}
+
+	InterlockedExchangeAdd( &wb->completed, count );
+	SetEvent( wb->idle );
+}
+
+/*
+ * odbc_writebehind_thread
+ *
+ * Drains the queue, committing every ODBC_WRITEBEHIND_BATCH statements, after a failed statement
+ * and whenever the queue runs empty.
+ */
+
+DWORD WINAPI odbc_writebehind_thread( LPVOID context )
+{
+	int pending, group_failed;
+	int failed[ ODBC_WRITEBEHIND_BATCH ];
+	ODBCWriteEntry *group[ ODBC_WRITEBEHIND_BATCH ];
+	ODBCWriteBehind *wb;
+
+	wb = ( ODBCWriteBehind * ) context;
+
+	for ( ;; )
+	{
+		WaitForSingleObject( wb->wake, 1000 );
+
+		for ( pending = 0, group_failed = 0; wb->head != wb->tail; )
+		{
+			MemoryBarrier();
+
+			group[ pending ]	= wb->ring[ wb->head % wb->capacity ];
+			failed[ pending ]	= !odbc_writebehind_execute( wb, group[ pending ] );
+			group_failed		|= failed[ pending ];
+
+			InterlockedIncrement( &wb->head );
+
+			if ( ++pending == ODBC_WRITEBEHIND_BATCH || group_failed )
 			{
-				value_string	= mvVariable_Value( variable, &value_string_length );
+				odbc_writebehind_commit( wb, group, failed, pending, group_failed );
+
+				pending			= 0;
+				group_failed	= 0;
+			}
+		}
+
+		if ( pending )
+		{
+			odbc_writebehind_commit( wb, group, failed, pending, group_failed );
+		}
+
+		if ( wb->stop && wb->head == wb->tail )
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * odbc_writebehind_report
+ *
+ * Logs write-behind failures recorded by the worker since the last report
+ */
+
+void odbc_writebehind_report( ODBCDatabase *db )
+{
+	LONG failures;
+	ODBCWriteBehind *wb;
+
+	if ( ( wb = db->writebehind ) == NULL || ( failures = wb->failures ) == wb->failures_reported )
+	{
+		return;
+	}
+
+	EnterCriticalSection( &wb->lock );
+	odbc_log( db, "*** Write-behind: %d statements failed, last error: %s\n", ( int ) ( failures - wb->failures_reported ), wb->last_error );
+	LeaveCriticalSection( &wb->lock );
+
+	wb->failures_reported = failures;
+}
+
+/*
+ * odbc_writebehind_flush
+ *
+ * Waits until every queued statement has been executed and committed
+ */
+
+void odbc_writebehind_flush( ODBCDatabase *db )
+{
+	ODBCWriteBehind *wb;
+
+	if ( ( wb = db->writebehind ) == NULL )
+	{
+		return;
+	}
+
+	while ( wb->completed != wb->submitted )
+	{
+		SetEvent( wb->wake );
+		WaitForSingleObject( wb->idle, 100 );
+	}
+
+	odbc_writebehind_report( db );
+}
+
+/*
+ * odbc_writebehind_stop
+ */
+
+void odbc_writebehind_stop( ODBCDatabase *db )
+{
+	ODBCWriteBehind *wb;
+
+	if ( ( wb = db->writebehind ) == NULL )
+	{
+		return;
+	}
+
+	odbc_writebehind_flush( db );
+
+	wb->stop = 1;
+	SetEvent( wb->wake );
+	WaitForSingleObject( wb->thread, INFINITE );
+
+	odbc_log( db, "--- Write-behind stopped: statements = %d, failures = %d\n", ( int ) wb->submitted, ( int ) wb->failures );
+
+	CloseHandle( wb->thread );
+	CloseHandle( wb->wake );
+	CloseHandle( wb->idle );
+	DeleteCriticalSection( &wb->lock );
+
+	SQLFreeStmt( wb->hSTMT, SQL_DROP );
+	odbc_pool_checkin( wb->connection, 1 );
+
+	mvProgram_Free( NULL, wb->ring );
+	mvProgram_Free( NULL, wb );
+
+	db->writebehind = NULL;
+}
+
+/*
+ * odbc_writebehind_start
+ */
+
+int odbc_writebehind_start( ODBCDatabase *db, int capacity )
+{
+	ODBCWriteBehind *wb;
+
+	if ( db->writebehind )
+	{
+		return 1;
+	}
+
+	if ( db->connection == NULL )
+	{
+		strcpy( db->error, "Write-behind requires a pooled connection" );
+		return 0;
+	}
+
+	wb				= ( ODBCWriteBehind * ) odbc_allocate( db, sizeof( ODBCWriteBehind ) );
+	memset( wb, 0, sizeof( ODBCWriteBehind ) );
+
+	wb->capacity	= ( capacity > 0 ) ? capacity : 1024;
+	wb->ring		= ( ODBCWriteEntry ** ) odbc_allocate( db, sizeof( ODBCWriteEntry * ) * wb->capacity );
+	wb->hSTMT		= SQL_NULL_HSTMT;
+
+	InitializeCriticalSection( &wb->lock );
+
+	if ( ( wb->connection = odbc_pool_checkout( db, db->connection->key, db->connection->key_length ) ) == NULL )
+	{
+		goto error;
+	}
+
+	if ( SQLAllocStmt( wb->connection->hDBC, &wb->hSTMT ) != SQL_SUCCESS )
+	{
+		odbc_error( db, "SQLAllocStmt: ", wb->connection->hDBC, SQL_HANDLE_DBC );
+
+		wb->hSTMT = SQL_NULL_HSTMT;
+		goto error;
+	}
+
+	wb->wake		= CreateEvent( NULL, FALSE, FALSE, NULL );
+	wb->idle		= CreateEvent( NULL, FALSE, FALSE, NULL );
+
+	if ( wb->wake == NULL || wb->idle == NULL || ( wb->thread = CreateThread( NULL, 0, odbc_writebehind_thread, wb, 0, NULL ) ) == NULL )
+	{
+		sprintf( db->error, "Unable to start the write-behind thread (%u)", ( unsigned int ) GetLastError() );
+		goto error;
+	}
+
+	db->writebehind = wb;
+
+	odbc_log( db, "--- Write-behind started: queue = %d\n", wb->capacity );
+	return 1;
+
+error:
+
+	if ( wb->wake )							CloseHandle( wb->wake );
+	if ( wb->idle )							CloseHandle( wb->idle );
+	if ( wb->hSTMT != SQL_NULL_HSTMT )		SQLFreeStmt( wb->hSTMT, SQL_DROP );
+	if ( wb->connection )					odbc_pool_checkin( wb->connection, 1 );
+
+	DeleteCriticalSection( &wb->lock );
+	mvProgram_Free( NULL, wb->ring );
+	mvProgram_Free( NULL, wb );
+
+	return 0;
+}
+
+/*
+ * odbc_writebehind_push
+ *
+ * Copies a statement and its parameter values into the queue and returns without waiting for it.
+ * When the queue is full the script's thread waits for the worker to make room.
+ */
+
+int odbc_writebehind_push( ODBCDatabase *db, const char *query, int query_length, mvVariableList input )
+{
+	int i, size, param_count, value_length;
+	char *data;
+	const char *value;
+	mvVariable variable;
+	ODBCWriteEntry *entry;
+	ODBCWriteBehind *wb;
+
+	wb			= db->writebehind;
+	param_count	= mvVariableList_Entries( input );
+	size		= ODBC_STORE_ALIGN( sizeof( ODBCWriteEntry ) ) +
+				  ODBC_STORE_ALIGN( sizeof( SQLLEN ) * param_count ) +
+				  ODBC_STORE_ALIGN( sizeof( char * ) * param_count ) +
+				  ODBC_STORE_ALIGN( sizeof( int ) * param_count ) +
+				  query_length + 1;
+
+	for ( variable = mvVariableList_First( input ); variable; variable = mvVariableList_Next( input ) )
+	{
+		mvVariable_Value( variable, &value_length );
+		size += value_length + 1;
+	}
+
+	data					= ( char * ) odbc_allocate( db, size );
+	entry					= ( ODBCWriteEntry * ) data;				data += ODBC_STORE_ALIGN( sizeof( ODBCWriteEntry ) );
+	entry->indicators		= ( SQLLEN * ) data;						data += ODBC_STORE_ALIGN( sizeof( SQLLEN ) * param_count );
+	entry->values			= ( char ** ) data;							data += ODBC_STORE_ALIGN( sizeof( char * ) * param_count );
+	entry->lengths			= ( int * ) data;							data += ODBC_STORE_ALIGN( sizeof( int ) * param_count );
+	entry->param_count		= param_count;
+	entry->query			= data;
+	entry->query_length		= query_length;
+
+	memcpy( data, query, query_length );
+	data[ query_length ]	= '\0';
+	data					+= query_length + 1;
+
+	for ( i = 0, variable = mvVariableList_First( input ); variable; i++, variable = mvVariableList_Next( input ) )
+	{
+		value				= mvVariable_Value( variable, &value_length );
+		entry->values[ i ]	= data;
+		entry->lengths[ i ]	= value_length;
+
+		memcpy( data, value, value_length );
+		data[ value_length ]	= '\0';
+		data					+= value_length + 1;
+	}
+
+	while ( wb->tail - wb->head >= wb->capacity )
+	{
+		SetEvent( wb->wake );
+		WaitForSingleObject( wb->idle, 10 );
+	}
+
+	wb->ring[ wb->tail % wb->capacity ] = entry;
+
+	MemoryBarrier();
+	InterlockedIncrement( &wb->tail );
+
+	wb->submitted++;
+	SetEvent( wb->wake );
+
+	odbc_writebehind_report( db );
+	return 1;
+}
+
+/*
+ * odbc_db_close
+ */
+
+int	odbc_db_close( mvDatabase db )
+{
+	ODBCDatabase *dbcontext;
+
+	dbcontext = ( ODBCDatabase * ) mvDatabase_data( db );
+
+	if ( dbcontext->batch )
+	{
+		odbc_batch_flush( dbcontext );
+		odbc_batch_free( dbcontext );
+	}
+
+	odbc_group_commit( dbcontext );
+	odbc_writebehind_stop( dbcontext );
+	odbc_replica_free( dbcontext );
+
+	if ( dbcontext->parameters )
+	{
+		mvProgram_Free( NULL, dbcontext->parameters );
+	}
+
+	odbc_param_cache_trim( dbcontext, 0 );
+	odbc_shape_cache_trim( dbcontext, 0 );
+
+	odbc_log( dbcontext, "*** Statement cache: hits = %u, misses = %u\n", dbcontext->stmt_hits, dbcontext->stmt_misses );
+	odbc_statement_trim( dbcontext, 0 );
+	
+	if ( dbcontext->connection )
+	{
+		odbc_pool_checkin( dbcontext->connection, !dbcontext->nopool );
+	}
+
+	if ( dbcontext->log )
+	{
+		mvFile_Close( dbcontext->log );
+	}
+
+	if ( dbcontext->slowlog )
+	{
+		mvFile_Close( dbcontext->slowlog );
+	}
+
+	mvProgram_Free( NULL, dbcontext );
+	return 1;
+}
+
+/*
+ * odbc_view_materialize
+ *
+ * Reads the rest of a firehose view's result into its row store
+ */
+
+int odbc_view_materialize( ODBCDatabaseView *viewcontext )
+{
+	int first_row;
+	ODBCRowStore *store;
+
+	store = viewcontext->store;
+
+	if ( !odbc_store_settle( viewcontext ) )			return 0;
+
+	/* Rows past the store limit are spilled rather than dropped, since the cursor cannot serve them again */
+
+	first_row		= store->first_row;
+	store->eager	= 1;
+	store->spill	= ( store->limit > 0 );
+
+	if ( !odbc_load_row( viewcontext, 0x7FFFFFFF ) )	return 0;
+
+	if ( store->first_row != first_row )
+	{
+		sprintf( viewcontext->db->error, "Unable to materialize the view: the result exceeds the row store limit of %d bytes and could not be spilled to a temporary file", store->limit );
+		return 0;
+	}
+
+	odbc_log( viewcontext->db, "--- Materialized %d rows, %d bytes in memory, %u bytes spilled\n",
+			  store->next_row - 1, store->bytes, ( unsigned int ) store->spill_size );
+
+	return 1;
+}
+
+/*
+ * odbc_view_detach
+ *
+ * Stops fetching into the view's buffers so that its statement can be closed or handed to another view
+ */
+
+void odbc_view_detach( ODBCDatabaseView *viewcontext )
+{
+	odbc_prefetch_stop( viewcontext );
+
+	if ( viewcontext->hSTMT == SQL_NULL_HSTMT )
+	{
+		return;
+	}
+
+	if ( viewcontext->rowset_size > 1 )
+	{
+		SQLSetStmtAttr( viewcontext->hSTMT, SQL_ATTR_ROW_ARRAY_SIZE,	( SQLPOINTER ) 1,	0 );
+		SQLSetStmtAttr( viewcontext->hSTMT, SQL_ATTR_ROW_STATUS_PTR,	NULL,				0 );
+		SQLSetStmtAttr( viewcontext->hSTMT, SQL_ATTR_ROWS_FETCHED_PTR,	NULL,				0 );
+	}
+
+	SQLFreeStmt( viewcontext->hSTMT, SQL_UNBIND );
+}
+
+/*
+ * odbc_firehose_release
+ *
+ * Reads the rest of the firehose view that holds a connection into its row store and closes its
+ * cursor, so that another statement can run on a connection that allows only one active statement.
+ * holder is the connection's firehose_view, that of the database or of a read replica.
+ */
+
+int odbc_firehose_release( ODBCDatabase *db, ODBCDatabaseView **holder )
+{
+	int row;
+	ODBCDatabaseView *view;
+
+	if ( ( view = *holder ) == NULL )
+	{
+		return 1;
+	}
+
+	*holder = NULL;
+
+	if ( db->results_view == view )
+	{
+		db->results_view = NULL;
+	}
+
+	if ( !view->store->complete )
+	{
+		odbc_log( db, "--- Reading the rest of the open firehose view, the connection allows one active statement\n" );
+
+		row = view->recno->data_integer;
+
+		if ( !odbc_view_materialize( view ) )	return 0;
+		if ( !odbc_load_row( view, row ) )		return 0;
+	}
+
+	odbc_view_detach( view );
+	SQLCloseCursor( view->hSTMT );
+
+	return 1;
+}
+
+/*
+ * odbc_firehose_yield
+ *
+ * Releases the primary connection from the firehose view that holds it
+ */
+
+int odbc_firehose_yield( ODBCDatabase *db )
+{
+	return odbc_firehose_release( db, &db->firehose_view );
+}
+
+/*
+ * odbc_view_start
+ *
+ * Binds the view's buffers to its executed statement and loads the first row
+ */
+
+int odbc_view_start( ODBCDatabaseView *viewcontext )
+{
+	if ( !odbc_bind_buffers( viewcontext ) )										return 0;
+	if ( viewcontext->rowset_size > 1 && !odbc_bind_rowset( viewcontext ) )		return 0;
+
+	if ( viewcontext->buffer_span && viewcontext->rowset_size > 1 )
+	{
+		odbc_prefetch_start( viewcontext );
+	}
 
-				parameter_data[ param ].data_string			= ( char * ) mvProgram_Allocate( NULL, value_string_length );
-				parameter_data[ param ].data_string_length	= value_string_length;
-				parameter_data[ param ].cbData				= SQL_LEN_DATA_AT_EXEC( 0 );
+	if ( viewcontext->firehose )
+	{
+		viewcontext->store			= odbc_store_create( viewcontext->db );
 
-				memcpy( parameter_data[ param ].data_string, value_string, value_string_length );
+		/* Cached results must be complete, and a prefetched rowset moves the cursor off the current one */
 
-				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_BINARY, datatype,
-									   0, 0, ( SQLPOINTER ) param, 0, &parameter_data[ param ].cbData ) == SQL_ERROR )
-				{
-					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
-					goto error;
-				}
+		viewcontext->store->eager	= ( viewcontext->cache_key != NULL || viewcontext->prefetch_thread != NULL );
 
-				break;
-			}
-			case SQL_BIGINT :
-			case SQL_TINYINT :
-			case SQL_SMALLINT :
-			case SQL_INTEGER :
-			{
-				parameter_data[ param ].data_integer	= mvVariable_Value_Integer( variable );
-				parameter_data[ param ].cbData			= sizeof( int );
+		if ( viewcontext->db->materialize )
+		{
+			/* Read the whole result into the row store and release the server cursor early */
 
-				odbc_log( db, "+++ Parameter %d value (integer): %d\n", param + 1, parameter_data[ param ].data_integer );
+			if ( !odbc_view_materialize( viewcontext ) )	return 0;
 
-				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_SLONG, datatype, 0, 0,
-									   &parameter_data[ param ].data_integer, 0,
-									   &parameter_data[ param ].cbData ) == SQL_ERROR )
-				{
-					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
-					goto error;
-				}
+			SQLCloseCursor( viewcontext->hSTMT );
+		}
+		else
+		{
+			viewcontext->db->results_view = viewcontext;
 
-				break;
-			}
-			case SQL_BIT :
+			if ( viewcontext->connection == NULL && odbc_single_activity( viewcontext->db, viewcontext->replica ) )
 			{
-				parameter_data[ param ].data_integer	= mvVariable_Value_Integer( variable ) ? 1 : 0;
-				parameter_data[ param ].cbData			= sizeof( int );
+				if ( viewcontext->replica )	viewcontext->replica->firehose_view	= viewcontext;
+				else						viewcontext->db->firehose_view		= viewcontext;
+			}
+		}
+	}
 
-				odbc_log( db, "+++ Parameter %d value (integer): %d\n", param + 1, parameter_data[ param ].data_integer );
+	return odbc_load_row( viewcontext, 1 );
+}
 
-				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_SLONG, datatype, 0, 0,
-									   &parameter_data[ param ].data_integer, 0,
-									   &parameter_data[ param ].cbData ) == SQL_ERROR )
-				{
-					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
-					goto error;
-				}
+/*
+ * odbc_async_thread
+ *
+ * Executes an asynchronously opened view on its own connection
+ */
 
-				break;
-			}
-			case SQL_NUMERIC :
-			case SQL_DECIMAL :
-			case SQL_REAL :
-			case SQL_FLOAT :
-			case SQL_DOUBLE :
-			{
-				parameter_data[ param ].data_double		= mvVariable_Value_Double( variable );
-				parameter_data[ param ].cbData			= sizeof( double );
+DWORD WINAPI odbc_async_thread( LPVOID context )
+{
+	ODBCDatabaseView *view;
 
-				odbc_log( db, "+++ Parameter %d value (double): %f\n", param + 1, parameter_data[ param ].data_double );
+	view = ( ODBCDatabaseView * ) context;
 
-				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_DOUBLE, datatype,
-									   column_size, digits,
-									   &parameter_data[ param ].data_double, 0,
-									   &parameter_data[ param ].cbData ) == SQL_ERROR )
-				{
-					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
-					goto error;
-				}
+	if ( view->firehose )
+	{
+		SQLSetStmtAttr( view->hSTMT, SQL_ATTR_CURSOR_TYPE,	( SQLPOINTER ) SQL_CURSOR_FORWARD_ONLY,	0 );
+		SQLSetStmtAttr( view->hSTMT, SQL_ATTR_CONCURRENCY,	( SQLPOINTER ) SQL_CONCUR_READ_ONLY,	0 );
+	}
+	else
+	{
+		if ( SQLSetStmtOption( view->hSTMT, SQL_CURSOR_TYPE, SQL_CURSOR_STATIC ) != SQL_SUCCESS )
+		{
+			view->forwardonly = 1;
+		}
 
-				break;
-			}
-			case SQL_CHAR :
-			case SQL_VARCHAR :
-			default :
-			{
-				value_string						= mvVariable_Value( variable, &value_string_length );
-				parameter_data[ param ].data_string	= ( char * ) mvProgram_Allocate( NULL, value_string_length );
-				
-				if ( db->truncate && ( column_size != -1 ) && ( value_string_length > ( int ) column_size ) )
-				{
-					parameter_data[ param ].cbData		= column_size;
-				}
-				else
-				{
-					parameter_data[ param ].cbData		= value_string_length;
-				}
+		SQLSetStmtOption( view->hSTMT, SQL_ROWSET_SIZE, 1 );
+	}
 
-				memcpy( parameter_data[ param ].data_string, value_string, value_string_length );
+	view->async_retcode = SQLExecDirect( view->hSTMT, ( SQLCHAR * ) view->async_query, view->async_query_length );
 
-				odbc_log( db, "+++ Parameter %d value (string): length = %d, cbData = %d, data = '%.*s'\n",
-						  param + 1, 
-						  value_string_length,
-						  parameter_data[ param ].cbData,
-						  parameter_data[ param ].cbData < 4096 ? parameter_data[ param ].cbData : 4096,
-						  parameter_data[ param ].data_string );
+	return 0;
+}
 
-				if ( SQLBindParameter( hSTMT, param + 1, SQL_PARAM_INPUT, SQL_C_CHAR, datatype, 0, 0,
-									   parameter_data[ param ].data_string, parameter_data[ param ].cbData,
-									   &parameter_data[ param ].cbData ) == SQL_ERROR )
-				{
-					odbc_error( db, "SQLBindParameter: ", hSTMT, SQL_HANDLE_STMT );
-					goto error;
-				}
+/*
+ * odbc_async_start
+ *
+ * Starts executing a view on a separate pooled connection.  Only views without input parameters,
+ * outside of a transaction and with a cached result shape qualify, since the shape is needed to
+ * add the view's variables before the result exists.  Returns 0 if the view should be opened
+ * synchronously instead.
+ */
 
-				break;
-			}
-		}	
+int odbc_async_start( ODBCDatabase *db, ODBCDatabaseView *viewcontext, const char *query, int query_length, mvVariableList list )
+{
+	if ( !db->async_open || !db->autocommit || db->in_transaction || db->group_pending || db->connection == NULL || mvVariableList_Entries( list ) )
+	{
+		return 0;
 	}
 
-	if ( ( retcode = SQLExecute( hSTMT ) ) == SQL_ERROR )
+	if ( ( viewcontext->shape = odbc_shape_lookup( db, query, query_length ) ) == NULL )
+	{
+		return 0;
+	}
+
+	if ( ( viewcontext->replica = odbc_replica_route( db, query, query_length, 0 ) ) != NULL )
+	{
+		viewcontext->connection = odbc_pool_checkout( db, viewcontext->replica->key, viewcontext->replica->key_length );
+	}
+	else
+	{
+		viewcontext->connection = odbc_pool_checkout( db, db->connection->key, db->connection->key_length );
+	}
+
+	if ( viewcontext->connection == NULL )
 	{
-		odbc_error( db, "SQLExecute: ", hSTMT, SQL_HANDLE_STMT );
 		goto error;
 	}
 
-	while ( retcode == SQL_NEED_DATA )
+	if ( SQLAllocStmt( viewcontext->connection->hDBC, &viewcontext->hSTMT ) != SQL_SUCCESS )
 	{
-		if ( ( retcode = SQLParamData( hSTMT, &pToken ) ) == SQL_NEED_DATA )
-		{
-			param = ( int ) pToken;
+		odbc_error( db, "SQLAllocStmt: ", viewcontext->connection->hDBC, SQL_HANDLE_DBC );
 
-			odbc_log( db, "+++ Parameter %d value (string at exec): length = %d, data = '%.*s'\n",
-					  param + 1,
-					  parameter_data[ param ].data_string_length,
-					  parameter_data[ param ].data_string_length < 4096 ? parameter_data[ param ].data_string_length : 4096,
-					  parameter_data[ param ].data_string );
-			
-			if ( SQLPutData( hSTMT,
-							 parameter_data[ param ].data_string,
-							 parameter_data[ param ].data_string_length ) != SQL_SUCCESS )
-			{
-				odbc_error( db, "SQLPutData: ", hSTMT, SQL_HANDLE_STMT );
-				//goto error;
-			}
-		}
-		else if ( retcode == SQL_ERROR )
-		{
-			odbc_error( db, "SQLParamData: ", hSTMT, SQL_HANDLE_STMT );
-			goto error;
-		}
+		viewcontext->hSTMT = SQL_NULL_HSTMT;
+		goto error;
 	}
 
-	for ( param = 0; param < numparams; param++ )
+	viewcontext->async_query		= ( char * ) odbc_allocate( db, query_length + 1 );
+	viewcontext->async_query_length	= query_length;
+
+	memcpy( viewcontext->async_query, query, query_length );
+	viewcontext->async_query[ query_length ] = '\0';
+
+	if ( ( viewcontext->async_thread = CreateThread( NULL, 0, odbc_async_thread, viewcontext, 0, NULL ) ) == NULL )
 	{
-		if ( parameter_data[ param ].data_string )	mvProgram_Free( NULL, parameter_data[ param ].data_string );
+		odbc_log( db, "+++ Unable to start the asynchronous open thread (%u)\n", ( unsigned int ) GetLastError() );
+		goto error;
 	}
 
-	mvProgram_Free( NULL, parameter_data );
+	odbc_log( db, "--- Opening view asynchronously\n" );
 	return 1;
 
 error:
-	
-	for ( param = 0; param < numparams; param++ )
-	{
-		if ( parameter_data[ param ].data_string )	mvProgram_Free( NULL, parameter_data[ param ].data_string );
-	}
 
-	mvProgram_Free( NULL, parameter_data );
+	if ( viewcontext->async_query )				mvProgram_Free( NULL, viewcontext->async_query );
+	if ( viewcontext->hSTMT != SQL_NULL_HSTMT )	SQLFreeStmt( viewcontext->hSTMT, SQL_DROP );
+	if ( viewcontext->connection )				odbc_pool_checkin( viewcontext->connection, 1 );
+	if ( viewcontext->replica )					odbc_replica_release( viewcontext->replica );
+
+	odbc_shape_release( viewcontext->shape );
+
+	viewcontext->replica		= NULL;
+	viewcontext->shape			= NULL;
+	viewcontext->connection		= NULL;
+	viewcontext->hSTMT			= SQL_NULL_HSTMT;
+	viewcontext->async_query	= NULL;
+
 	return 0;
 }
 
 /*
- * odbc_bind_columns
+ * odbc_view_ready
+ *
+ * Waits for an asynchronously opened view to finish executing, checks that its result still has
+ * the cached shape and loads the first row.  Called before any access to the view's data.
  */
 
-int odbc_bind_columns( mvDatabaseView view, ODBCDatabaseView *odbcview )
+int odbc_view_ready( ODBCDatabaseView *viewcontext )
 {
-	SWORD i, nCols;
-	ODBCDatabaseVariable *odbcvar;
-	UCHAR szColName[ 256 ];
-	SWORD cbColName;
-	SWORD fSqlType;
-	UDWORD ibPrecision;
-	SWORD ibScale;
-	SWORD fNullable;
-
-	/*
-	 * Setup "special" variables (recno, eof, deleted)
-	 */
-
-	odbcview->recno		= mvProgram_Allocate( NULL, sizeof( ODBCDatabaseVariable ) ); memset( odbcview->recno,		0, sizeof( ODBCDatabaseVariable ) );
-	odbcview->eof		= mvProgram_Allocate( NULL, sizeof( ODBCDatabaseVariable ) ); memset( odbcview->eof,		0, sizeof( ODBCDatabaseVariable ) );
-	odbcview->deleted	= mvProgram_Allocate( NULL, sizeof( ODBCDatabaseVariable ) ); memset( odbcview->deleted,	0, sizeof( ODBCDatabaseVariable ) );
-	
-	mvDatabaseView_AddVariable( view, "recno",		5, odbcview->recno );		odbcview->recno->type	= ODBC_INTEGER;
-	mvDatabaseView_AddVariable( view, "eof",		3, odbcview->eof );			odbcview->eof->type		= ODBC_INTEGER;
-	mvDatabaseView_AddVariable( view, "deleted",	7, odbcview->deleted );		odbcview->deleted->type	= ODBC_INTEGER;
-
-	/*
-	 * Bind the remainder of the results
-	 */
+	SWORD nCols;
 
-	if ( SQLNumResultCols( odbcview->hSTMT, &nCols ) != SQL_SUCCESS )								return odbc_error( odbcview->db, "SQLNumResultCols: ", odbcview->hSTMT, SQL_HANDLE_STMT );
+	if ( viewcontext->async_error )
+	{
+		strcpy( viewcontext->db->error, viewcontext->async_error );
+		return 0;
+	}
 
-	for ( i = 1; i <= nCols; i++ )
+	if ( viewcontext->async_thread == NULL )
 	{
-		odbcvar			= ( ODBCDatabaseVariable * ) mvProgram_Allocate( NULL, sizeof( ODBCDatabaseVariable ) );
-		memset( odbcvar, 0, sizeof( ODBCDatabaseVariable ) );
-		odbcvar->column	= i;
+		return 1;
+	}
 
-		if ( SQLDescribeCol( odbcview->hSTMT, i, szColName, sizeof( szColName ), &cbColName,
-							 &fSqlType, &ibPrecision, &ibScale, &fNullable ) != SQL_SUCCESS )	return odbc_error( odbcview->db, "SQLDescribeCol: ", odbcview->hSTMT, SQL_HANDLE_STMT );
+	WaitForSingleObject( viewcontext->async_thread, INFINITE );
+	CloseHandle( viewcontext->async_thread );
 
-		odbc_log( odbcview->db, "--- Result %d: name = '%.*s', sqltype = %d, precision = %d, scale = %d, nullable = %d\n",
-				  i,
-				  cbColName > 100 ? 100 : cbColName, szColName,
-				  fSqlType,
-				  ibPrecision,
-				  ibScale,
-				  fNullable );
+	viewcontext->async_thread = NULL;
 
-		switch ( fSqlType )
-		{
-			case SQL_BIGINT :
-			case SQL_TINYINT :
-			case SQL_SMALLINT :
-			case SQL_INTEGER :
-			case SQL_BIT :
-			{
-				odbcvar->type	= ODBC_INTEGER;
-				if ( SQLBindCol( odbcview->hSTMT, odbcvar->column, SQL_C_SLONG, &( odbcvar->data_integer ), sizeof( odbcvar->data_integer ), &( odbcvar->cbData  ) ) != SQL_SUCCESS )
-				{
-					return odbc_error( odbcview->db, "SQLBindCol: ", odbcview->hSTMT, SQL_HANDLE_STMT );
-				}
+	mvProgram_Free( NULL, viewcontext->async_query );
+	viewcontext->async_query = NULL;
 
-				break;
-			}
-			case SQL_NUMERIC :
-			case SQL_DECIMAL :
-			case SQL_REAL :
-			case SQL_FLOAT :
-			case SQL_DOUBLE :
-			{
-				odbcvar->type	= ODBC_DOUBLE;
-				if ( SQLBindCol( odbcview->hSTMT, odbcvar->column, SQL_C_DOUBLE, &( odbcvar->data_double ), sizeof( odbcvar->data_double ), &( odbcvar->cbData  ) ) != SQL_SUCCESS )
-				{
-					return odbc_error( odbcview->db, "SQLBindCol: ", odbcview->hSTMT, SQL_HANDLE_STMT );
-				}
+	if ( viewcontext->async_retcode == SQL_ERROR )
+	{
+		odbc_error( viewcontext->db, "SQLExecDirect: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
+		goto error;
+	}
 
-				break;
-			}
-			case SQL_LONGVARBINARY :
-			case SQL_LONGVARCHAR :
-			{
-				odbcvar->type			= ODBC_BLOB;
-				odbcvar->data_blob_stmt	= odbcview->hSTMT;
-				odbcvar->data_blob_col	= i;
+	if ( ( SQLNumResultCols( viewcontext->hSTMT, &nCols ) != SQL_SUCCESS ) || !odbc_shape_matches( viewcontext, viewcontext->shape, nCols ) )
+	{
+		strcpy( viewcontext->db->error, "The result columns of the view changed since the query was last opened" );
+		goto error;
+	}
 
-				break;
-			}
-			case SQL_CHAR :
-			default :
-			{
-				odbcvar->type	= ODBC_STRING;
+	if ( !odbc_view_start( viewcontext ) )
+	{
+		goto error;
+	}
 
-				if ( !ibPrecision && !ibScale )		odbcvar->data_string_size	= 50;
-				else								odbcvar->data_string_size	= ibPrecision + ibScale + 1;
+	return 1;
 
-				odbcvar->data_string	= ( char * ) mvProgram_Allocate( NULL, odbcvar->data_string_size + 1 );
-				if ( SQLBindCol( odbcview->hSTMT, odbcvar->column, SQL_C_CHAR, odbcvar->data_string, odbcvar->data_string_size, &( odbcvar->cbData  ) ) != SQL_SUCCESS )
-				{
-					return odbc_error( odbcview->db, "SQLBindCol: ", odbcview->hSTMT, SQL_HANDLE_STMT );
-				}
-				
-				break;
-			}
-		}
+error:
 
-		mvDatabaseView_AddVariable( view, szColName, cbColName, odbcvar );
-	}
+	viewcontext->eof->data_integer	= 1;
+	viewcontext->async_error		= ( char * ) odbc_allocate( viewcontext->db, strlen( viewcontext->db->error ) + 1 );
 
-	return 1;
+	strcpy( viewcontext->async_error, viewcontext->db->error );
+	return 0;
 }
 
 /*
- * odbc_load_row
+ * odbc_query_nextresult
+ *
+ * Returns 1 if the query text is the NEXTRESULT keyword, which opens the next result set of the
+ * most recently opened view's statement instead of executing anything.
  */
 
-int odbc_load_row( ODBCDatabaseView *view, int row )
+int odbc_query_nextresult( const char *query, int query_length )
 {
-	UDWORD cRow;
-	UWORD rgfStatus;
-
-	if ( view->forwardonly )
-	{
-		while ( ( view->eof->data_integer == 0 ) && ( view->recno->data_integer < row ) )
-		{
-			view->recno->data_integer++;
+	int length;
 
-			switch ( SQLExtendedFetch( view->hSTMT, SQL_FETCH_NEXT, row - view->recno->data_integer, &cRow, &rgfStatus ) ) 
-			{
-				case SQL_ERROR			: return odbc_error( view->db, "SQLExtendedFetch: ", view->hSTMT, SQL_HANDLE_STMT );
-				case SQL_NO_DATA_FOUND	: view->eof->data_integer = 1;	break;
-			}
-		}
-	}
-	else
+	if ( ( length = odbc_keyword( query, query_length, "nextresult" ) ) == 0 )
 	{
-		switch ( SQLExtendedFetch( view->hSTMT, SQL_FETCH_ABSOLUTE, row, &cRow, &rgfStatus ) ) 
-		{
-			case SQL_ERROR			: return odbc_error( view->db, "SQLExtendedFetch: ", view->hSTMT, SQL_HANDLE_STMT );
-			case SQL_NO_DATA_FOUND	: view->eof->data_integer = 1;		break;
-			default					: view->recno->data_integer = row;	break;
-		}
+		return 0;
 	}
 
-	view->deleted->data_integer	= ( rgfStatus == SQL_ROW_DELETED ) ? 1 : 0;
-
-	odbc_log( view->db, "*** odbc_load_row( %d ), eof = %d, deleted = %d\n",
-			  row,
-			  view->eof->data_integer,
-			  view->deleted->data_integer );
+	for ( ; length < query_length; length++ )
+	{
+		if ( query[ length ] != ' ' && query[ length ] != '\t' && query[ length ] != '\r' && query[ length ] != '\n' && query[ length ] != ';' )	return 0;
+	}
 
 	return 1;
 }
 
 /*
- * odbc_db_open
+ * odbc_view_nextresult
+ *
+ * Opens the next result set of the statement behind db->results_view.  The earlier view's remaining
+ * rows are read into its row store first, so that it can still be navigated after its statement
+ * moves on.  The statement, and the pooled connection of an asynchronously opened view, then belong
+ * to the new view.  Results without columns, such as row counts, are skipped.
  */
 
-int	odbc_db_open( mvDatabase db,
-				  const char *path,		int path_length,
-				  const char *name,		int name_path,
-				  const char *user,		int user_length, 
-				  const char *password,	int password_length ,
-				  const char *flags,	int flags_length )
+int odbc_view_nextresult( mvDatabase db, const char *name, int name_length, ODBCDatabaseView *viewcontext )
 {
-	int i, driverconnect;
+	int row;
+	SWORD nCols;
+	SQLRETURN retcode;
 	ODBCDatabase *dbcontext;
-	UCHAR szConnStrOut[ 255 ];
-	SWORD cbConnStrOut;
+	ODBCDatabaseView *previous;
+	mvDatabaseView view;
 
-	dbcontext = ( ODBCDatabase *) mvProgram_Allocate( NULL, sizeof( ODBCDatabase ) );
-	memset( dbcontext, 0, sizeof( ODBCDatabase ) );
-	mvDatabase_SetData( db, dbcontext );
+	dbcontext	= ( ODBCDatabase * ) mvDatabase_data( db );
+	previous	= dbcontext->results_view;
+
+	if ( previous == NULL )
+	{
+		strcpy( dbcontext->error, "NEXTRESULT requires an open firehose view whose statement has not been closed" );
+		goto error;
+	}
+
+	if ( !odbc_view_ready( previous ) )
+	{
+		goto error;
+	}
 
-	if ( SQLAllocEnv( &( dbcontext->hEnv ) ) == SQL_ERROR )													return odbc_error( dbcontext, "SQLAllocEnv: ", NULL, 0 );
-	if ( SQLAllocConnect( dbcontext->hEnv, &( dbcontext->hDBC ) ) == SQL_ERROR )							return odbc_error( dbcontext, "SQLAllocConnect: ", dbcontext->hEnv, SQL_HANDLE_ENV );
-	if ( SQLSetConnectAttr( dbcontext->hDBC, SQL_ATTR_AUTOCOMMIT, SQL_AUTOCOMMIT_OFF, 0 ) != SQL_SUCCESS )	return odbc_error( dbcontext, "SQLSetConnectAttr: ", dbcontext->hDBC, SQL_HANDLE_DBC );
+	/* Statements with further results must run again, so their first result is not cached */
 
-	dbcontext->autocommit	= 1;
-	driverconnect			= 0;
+	if ( previous->cached )		odbc_cache_discard( previous->cached );
 
-	for ( i = 0; i < path_length; i++ )
+	if ( previous->cache_key )
 	{
-		if ( path[ i ] == '=' )
-		{
-			driverconnect = 1;
-			break;
-		}
+		mvProgram_Free( NULL, previous->cache_key );
+		previous->cache_key = NULL;
 	}
 
-	if ( driverconnect )
+	row = previous->recno->data_integer;
+
+	if ( !odbc_view_materialize( previous ) )	goto error;
+	if ( !odbc_load_row( previous, row ) )		goto error;
+
+	odbc_view_detach( previous );
+
+	do
 	{
-		cbConnStrOut = sizeof( szConnStrOut );
-		if ( SQLDriverConnect( dbcontext->hDBC, NULL, ( UCHAR * ) path, ( SWORD ) path_length, 
-							   szConnStrOut, sizeof( szConnStrOut ), &cbConnStrOut, 
-							   SQL_DRIVER_NOPROMPT ) == SQL_ERROR )
+		if ( ( retcode = SQLMoreResults( previous->hSTMT ) ) == SQL_NO_DATA_FOUND )
 		{
-			odbc_error( dbcontext, "SQLDriverConnect: ", dbcontext->hDBC, SQL_HANDLE_DBC );
+			dbcontext->results_view = NULL;
+
+			strcpy( dbcontext->error, "The statement has no further result sets" );
 			goto error;
 		}
-	}
-	else
-	{
-		if ( SQLConnect( dbcontext->hDBC, ( UCHAR * ) path, ( SWORD ) path_length,
-						 ( UCHAR * ) user, ( SWORD ) user_length,
-						 ( UCHAR * ) password, ( SWORD ) password_length ) == SQL_ERROR )
+
+		if ( retcode == SQL_ERROR )
+		{
+			odbc_error( dbcontext, "SQLMoreResults: ", previous->hSTMT, SQL_HANDLE_STMT );
+			goto error;
+		}
+
+		if ( SQLNumResultCols( previous->hSTMT, &nCols ) != SQL_SUCCESS )
 		{
-			odbc_error( dbcontext, "SQLConnect: ", dbcontext->hDBC, SQL_HANDLE_DBC );
+			odbc_error( dbcontext, "SQLNumResultCols: ", previous->hSTMT, SQL_HANDLE_STMT );
 			goto error;
 		}
 	}
+	while ( nCols == 0 );
 
-	return 1;
+	/*
+	 * Result shapes are cached by query text, which only identifies the first result set
+	 */
+
+	viewcontext->hSTMT			= previous->hSTMT;
+	viewcontext->result			= previous->result + 1;
+
+	if ( ( viewcontext->shape = odbc_shape_create( viewcontext, previous->shape->hash, previous->shape->query, previous->shape->query_length, nCols ) ) == NULL )
+	{
+		goto error;
+	}
+
+	viewcontext->stmt			= previous->stmt;
+	viewcontext->connection		= previous->connection;
+	viewcontext->replica		= previous->replica;
+	viewcontext->forwardonly	= 1;
+	viewcontext->firehose		= 1;
+
+	previous->stmt				= NULL;
+	previous->hSTMT				= SQL_NULL_HSTMT;
+	previous->connection		= NULL;
+	previous->replica			= NULL;
+	dbcontext->results_view		= NULL;
+
+	if ( dbcontext->firehose_view == previous )
+	{
+		dbcontext->firehose_view = NULL;
+	}
+
+	if ( viewcontext->replica && viewcontext->replica->firehose_view == previous )
+	{
+		viewcontext->replica->firehose_view = NULL;
+	}
+
+	odbc_log( dbcontext, "--- Opening result set %d of the statement\n", viewcontext->result + 1 );
+
+	view = mvDatabase_AddView( db, name, name_length, viewcontext );
+
+	if ( !odbc_bind_columns( view, viewcontext ) )	return 0;
+
+	return odbc_view_start( viewcontext );
 
 error:
+
+	mvProgram_Free( NULL, viewcontext );
 	return 0;
 }
 
 /*
- * odbc_db_close
+ * odbc_cache_open
+ *
+ * Opens a view over a result cache entry.  The view has no statement; every row is served from a
+ * row store that reads the entry's chunks in place.
  */
 
-int	odbc_db_close( mvDatabase db )
+int odbc_cache_open( mvDatabase db, const char *name, int name_length, ODBCDatabaseView *viewcontext, ODBCCacheEntry *entry )
 {
 	ODBCDatabase *dbcontext;
+	ODBCResultShape *shape;
+	mvDatabaseView view;
 
-	dbcontext = ( ODBCDatabase * ) mvDatabase_data( db );
-	
-	if ( dbcontext->hDBC )
-	{
-		SQLDisconnect( dbcontext->hDBC );
-		SQLFreeConnect( dbcontext->hDBC );
-	}
+	dbcontext					= ( ODBCDatabase * ) mvDatabase_data( db );
 
-	if ( dbcontext->hEnv )
-	{
-		SQLFreeEnv( dbcontext->hEnv );
-	}
+	shape						= ( ODBCResultShape * ) odbc_allocate( dbcontext, sizeof( ODBCResultShape ) );
+	memset( shape, 0, sizeof( ODBCResultShape ) );
 
-	if ( dbcontext->log )
-	{
-		mvFile_Close( dbcontext->log );
-	}
+	shape->references			= 1;
+	shape->query				= ( char * ) odbc_allocate( dbcontext, 1 );
+	shape->query[ 0 ]			= '\0';
+	shape->column_count			= entry->column_count;
+	shape->columns				= ( ODBCColumnInfo * ) odbc_allocate( dbcontext, sizeof( ODBCColumnInfo ) * ( entry->column_count + 1 ) );
 
-	mvProgram_Free( NULL, dbcontext );
-	return 1;
+	memcpy( shape->columns, entry->columns, sizeof( ODBCColumnInfo ) * entry->column_count );
+
+	viewcontext->shape			= shape;
+	viewcontext->cached			= entry;
+	viewcontext->forwardonly	= 1;
+	viewcontext->firehose		= 1;
+	viewcontext->rowset_size	= 1;
+
+	viewcontext->store			= odbc_store_create( dbcontext );
+	viewcontext->store->first	= entry->first;
+	viewcontext->store->last	= entry->last;
+	viewcontext->store->next_row	= entry->rows + 1;
+	viewcontext->store->complete	= 1;
+	viewcontext->store->shared		= 1;
+	viewcontext->store->limit		= 0;
+
+	odbc_log( dbcontext, "--- Result cache hit: rows = %d\n", entry->rows );
+
+	view = mvDatabase_AddView( db, name, name_length, viewcontext );
+
+	if ( !odbc_bind_columns( view, viewcontext ) )	return 0;
+
+	return odbc_load_row( viewcontext, 1 );
 }
 
 /*
- * odbc_db_openview
+ * odbc_openview
  */
 
-int odbc_db_openview( mvDatabase db, const char *name, int name_length, const char *query, int query_length, mvVariableList list, int entries )
+int odbc_openview( mvDatabase db, const char *name, int name_length, const char *query, int query_length, mvVariableList list, int entries )
 {
 	ODBCDatabase *dbcontext;
 	ODBCDatabaseView *viewcontext;
+	ODBCCacheEntry *entry;
 	mvDatabaseView view;
 	UCHAR szSqlState[ 50 ];
 	SDWORD pfNativeError;
@@ -690,122 +7159,287 @@ int odbc_db_openview( mvDatabase db, const char *name, int name_length, const ch
 	SWORD cbErrorMessage;
 
 	dbcontext					= ( ODBCDatabase * ) mvDatabase_data( db );
-	viewcontext					= ( ODBCDatabaseView * ) mvProgram_Allocate( NULL, sizeof( ODBCDatabaseView ) );
+	viewcontext					= ( ODBCDatabaseView * ) odbc_allocate( dbcontext, sizeof( ODBCDatabaseView ) );
 
 	memset( viewcontext, 0, sizeof( ODBCDatabaseView ) );
 
 	viewcontext->db				= dbcontext;
-	viewcontext->forwardonly	= dbcontext->forwardonly;
+	viewcontext->forwardonly	= dbcontext->forwardonly || dbcontext->firehose;
+	viewcontext->firehose		= dbcontext->firehose;
+	viewcontext->rowset_size	= dbcontext->rowset_size;
+	viewcontext->rowset_next	= 1;
+	viewcontext->hSTMT			= SQL_NULL_HSTMT;
 
 	odbc_log( dbcontext, "*** MvOPENVIEW\n" );
 	odbc_log_data( dbcontext, query, query_length );
 
-	if ( SQLAllocStmt( dbcontext->hDBC, &( viewcontext->hSTMT ) ) != SQL_SUCCESS )
+	if ( dbcontext->batch && dbcontext->batch->stmt && !odbc_firehose_yield( dbcontext ) )
 	{
-		odbc_error( dbcontext, "SQLAllocStmt: ", dbcontext->hDBC, SQL_HANDLE_DBC );
 		goto error;
 	}
 
-	/* 
-	 * Some versions of the Oracle ODBC driver require us to make this call in order to return BLOB data correctly,
-	 * even if we are setting forwardonly to 1 above.
-	 */
+	if ( !odbc_batch_flush( dbcontext ) )
+	{
+		goto error;
+	}
 
-	switch ( SQLSetStmtOption( viewcontext->hSTMT, SQL_CURSOR_TYPE, SQL_CURSOR_STATIC ) )
+	if ( odbc_query_nextresult( query, query_length ) )
 	{
-		case SQL_SUCCESS_WITH_INFO :
-		{
-			if ( SQLError( dbcontext->hEnv, dbcontext->hDBC, viewcontext->hSTMT, szSqlState, &pfNativeError,
-						   szErrorMessage, sizeof( szErrorMessage ), &cbErrorMessage ) == SQL_SUCCESS )
-			{
-				if ( strcmp( ( const char * ) szSqlState, "IM001" ) )
-				{
-					odbc_error( dbcontext, "SQLSetStmtOption: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
-					goto error;
-				}
-			}
+		return odbc_view_nextresult( db, name, name_length, viewcontext );
+	}
 
-			/* Fall through */
-		}
-		case SQL_ERROR :
+	if ( dbcontext->result_cache && dbcontext->firehose && dbcontext->connection && dbcontext->autocommit && !dbcontext->in_transaction &&
+		 !dbcontext->group_pending && ( dbcontext->writebehind == NULL || dbcontext->writebehind->completed == dbcontext->writebehind->submitted ) &&
+		 odbc_keyword( query, query_length, "select" ) )
+	{
+		odbc_shared_attach( dbcontext );
+
+		viewcontext->cache_key	= odbc_cache_key( dbcontext, query, query_length, list, &viewcontext->cache_key_length );
+	}
+
+	if ( viewcontext->cache_key )
+	{
+		viewcontext->cache_hash	= odbc_statement_hash( viewcontext->cache_key, viewcontext->cache_key_length );
+
+		if ( ( entry = odbc_cache_lookup( dbcontext, viewcontext->cache_key, viewcontext->cache_key_length, viewcontext->cache_hash ) ) != NULL )
 		{
-			viewcontext->forwardonly = 1;
-			break;
+			mvProgram_Free( NULL, viewcontext->cache_key );
+			viewcontext->cache_key = NULL;
+
+			return odbc_cache_open( db, name, name_length, viewcontext, entry );
 		}
-		default :
+
+		viewcontext->cache_tables = odbc_cache_tables( dbcontext, query, query_length );
+		odbc_cache_used = 1;
+
+		odbc_shared_tags( viewcontext->cache_tables, &viewcontext->cache_tags );
+		odbc_generations_capture( &odbc_generations, viewcontext->cache_tables, &viewcontext->cache_local );
+	}
+
+	if ( odbc_async_start( dbcontext, viewcontext, query, query_length, list ) )
+	{
+		view = mvDatabase_AddView( db, name, name_length, viewcontext );
+		return odbc_bind_columns( view, viewcontext );
+	}
+
+	if ( ( viewcontext->replica = odbc_replica_route( dbcontext, query, query_length, 1 ) ) != NULL )
+	{
+		/* Statements on a replica are not cached, the statement cache belongs to the primary */
+
+		odbc_log( dbcontext, "--- Routed to read replica %s\n", viewcontext->replica->key );
+
+		if ( odbc_firehose_release( dbcontext, &viewcontext->replica->firehose_view ) )
 		{
-			break;
+			viewcontext->stmt = odbc_statement_create( dbcontext, viewcontext->replica->connection->hDBC, dbcontext->firehose ? ODBC_STATEMENT_FIREHOSE : ODBC_STATEMENT_VIEW, query, query_length );
 		}
 	}
+	else if ( odbc_firehose_yield( dbcontext ) )
+	{
+		viewcontext->stmt = odbc_statement_acquire( dbcontext, dbcontext->firehose ? ODBC_STATEMENT_FIREHOSE : ODBC_STATEMENT_VIEW, query, query_length );
+	}
 
-	if ( SQLSetStmtOption( viewcontext->hSTMT, SQL_ROWSET_SIZE, 1 ) == SQL_ERROR )
+	if ( viewcontext->stmt == NULL )
 	{
-		odbc_error( dbcontext, "SQLSetStmtOption: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
 		goto error;
 	}
 
-	if ( SQLPrepare( viewcontext->hSTMT, ( char * ) query, query_length ) == SQL_ERROR )
+	viewcontext->hSTMT			= viewcontext->stmt->hSTMT;
+
+	if ( !viewcontext->stmt->prepared && dbcontext->firehose )
 	{
-		odbc_error( dbcontext, "SQLPrepare: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
-		goto error;
+		/*
+		 * Forward-only, read-only cursors stream rows as the server produces them instead of
+		 * materializing the result first.  Backward navigation is served from the row store.
+		 */
+
+		if ( ( SQLSetStmtAttr( viewcontext->hSTMT, SQL_ATTR_CURSOR_TYPE,	( SQLPOINTER ) SQL_CURSOR_FORWARD_ONLY,	0 ) == SQL_ERROR ) ||
+			 ( SQLSetStmtAttr( viewcontext->hSTMT, SQL_ATTR_CONCURRENCY,	( SQLPOINTER ) SQL_CONCUR_READ_ONLY,	0 ) == SQL_ERROR ) )
+		{
+			odbc_error( dbcontext, "SQLSetStmtAttr: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
+			goto error;
+		}
+
+		viewcontext->stmt->forwardonly = 1;
+
+		if ( !odbc_prepare( dbcontext, viewcontext->stmt, list ) )	goto error;
+	}
+	else if ( !viewcontext->stmt->prepared )
+	{
+		/* 
+		 * Some versions of the Oracle ODBC driver require us to make this call in order to return BLOB data correctly,
+		 * even if we are setting forwardonly to 1 above.
+		 */
+
+		switch ( SQLSetStmtOption( viewcontext->hSTMT, SQL_CURSOR_TYPE, SQL_CURSOR_STATIC ) )
+		{
+			case SQL_SUCCESS_WITH_INFO :
+			{
+				if ( SQLError( dbcontext->hEnv, dbcontext->hDBC, viewcontext->hSTMT, szSqlState, &pfNativeError,
+							   szErrorMessage, sizeof( szErrorMessage ), &cbErrorMessage ) == SQL_SUCCESS )
+				{
+					if ( strcmp( ( const char * ) szSqlState, "IM001" ) )
+					{
+						odbc_error( dbcontext, "SQLSetStmtOption: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
+						goto error;
+					}
+				}
+
+				/* Fall through */
+			}
+			case SQL_ERROR :
+			{
+				viewcontext->stmt->forwardonly = 1;
+				break;
+			}
+			default :
+			{
+				break;
+			}
+		}
+
+		if ( SQLSetStmtOption( viewcontext->hSTMT, SQL_ROWSET_SIZE, 1 ) == SQL_ERROR )
+		{
+			odbc_error( dbcontext, "SQLSetStmtOption: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
+			goto error;
+		}
+
+		if ( !odbc_prepare( dbcontext, viewcontext->stmt, list ) )	goto error;
+	}
+
+	if ( viewcontext->stmt->forwardonly )
+	{
+		viewcontext->forwardonly = 1;
 	}
 
-	if ( !odbc_execute( dbcontext, viewcontext->hSTMT, list ) )	goto error;
+	if ( !odbc_execute( dbcontext, viewcontext->stmt, list ) )	goto error;
 
 	view	= mvDatabase_AddView( db, name, name_length, viewcontext );
 
-	if ( !odbc_bind_columns( view, viewcontext ) )				goto error;
-	if ( !odbc_load_row( viewcontext, 1 ) )						goto error;
+	if ( !odbc_bind_columns( view, viewcontext ) )				return 0;
 
-	return 1;
+	return odbc_view_start( viewcontext );
 
 error:
+
+	if ( viewcontext->stmt )	odbc_statement_release( dbcontext, viewcontext->stmt, 0 );
+	if ( viewcontext->replica )	odbc_replica_release( viewcontext->replica );
+	if ( viewcontext->cache_key )		mvProgram_Free( NULL, viewcontext->cache_key );
+	if ( viewcontext->cache_tables )	mvProgram_Free( NULL, viewcontext->cache_tables );
+	mvProgram_Free( NULL, viewcontext );
+
 	return 0;
 }
 
 /*
- * odbc_db_runquery
+ * odbc_db_openview
  */
 
-int odbc_db_runquery( mvDatabase db, const char *query, int query_length, mvVariableList list, int entries )
+int odbc_db_openview( mvDatabase db, const char *name, int name_length, const char *query, int query_length, mvVariableList list, int entries )
 {
-	SQLHSTMT hSTMT;
+	int result;
+	LONGLONG start, rows;
+	ODBCDatabase *dbcontext;
+
+	dbcontext	= ( ODBCDatabase * ) mvDatabase_data( db );
+	rows		= dbcontext->stats.rows;
+
+	if ( dbcontext->slowlog )	memset( dbcontext->statement_ticks, 0, sizeof( dbcontext->statement_ticks ) );
+
+	start	= odbc_timer();
+	result	= odbc_openview( db, name, name_length, query, query_length, list, entries );
+
+	odbc_stats_record( dbcontext, ODBC_PHASE_OPENVIEW, start );
+
+	if ( dbcontext->slowlog )	odbc_slowlog( dbcontext, "MvOPENVIEW", query, query_length, list, result, dbcontext->stats.rows - rows );
+
+	return result;
+}
+
+/*
+ * odbc_runquery
+ */
+
+int odbc_runquery( mvDatabase db, const char *query, int query_length, mvVariableList list, int entries )
+{
+	ODBCStatement *stmt;
 	ODBCDatabase *dbcontext;
 
-	hSTMT		= SQL_NULL_HSTMT;
 	dbcontext	= ( ODBCDatabase * ) mvDatabase_data( db );
 
 	odbc_log( dbcontext, "*** MvQUERY\n" );
 	odbc_log_data( dbcontext, query, query_length );
 
-	if ( SQLAllocStmt( dbcontext->hDBC, &hSTMT ) == SQL_ERROR )
+	dbcontext->last_write = GetTickCount64();
+
+	/*
+	 * Cached results are invalidated before the statement runs or is queued, and again once it
+	 * commits, so that results read by other connections in between do not outlive it.
+	 */
+
+	odbc_cache_invalidate( dbcontext, query, query_length );
+
+	if ( dbcontext->batch )
 	{
-		odbc_error( dbcontext, "SQLAllocStmt: ", dbcontext->hDBC, SQL_HANDLE_DBC );
-		goto error;
+		if ( !odbc_firehose_yield( dbcontext ) )	return 0;
+
+		if ( mvVariableList_Entries( list ) )		return odbc_batch_add( dbcontext, query, query_length, list );
+		if ( !odbc_batch_flush( dbcontext ) )		return 0;
 	}
 
-	if ( SQLPrepare( hSTMT, ( char * ) query, query_length ) == SQL_ERROR )
+	if ( dbcontext->writebehind && dbcontext->autocommit && !dbcontext->in_transaction )
 	{
-		odbc_error( dbcontext, "SQLPrepare: ", hSTMT, SQL_HANDLE_STMT );
-		goto error;
+		return odbc_writebehind_push( dbcontext, query, query_length, list );
 	}
 
-	if ( !odbc_execute( dbcontext, hSTMT, list ) )	goto error;
+	if ( !odbc_firehose_yield( dbcontext ) )
+	{
+		return 0;
+	}
 
-	if ( dbcontext->autocommit && !dbcontext->in_transaction )
+	if ( ( stmt = odbc_statement_acquire( dbcontext, ODBC_STATEMENT_QUERY, query, query_length ) ) == NULL )
 	{
-		SQLEndTran( SQL_HANDLE_DBC, dbcontext->hDBC, SQL_COMMIT );
+		return 0;
 	}
 
-	SQLFreeStmt( hSTMT, SQL_DROP );
+	if ( !odbc_prepare( dbcontext, stmt, list ) )	goto error;
+	if ( !odbc_execute( dbcontext, stmt, list ) )	goto error;
+
+	odbc_autocommit( dbcontext );
+
+	odbc_statement_release( dbcontext, stmt, 1 );
 	return 1;
 
 error:
 
-	if ( hSTMT != SQL_NULL_HSTMT )	SQLFreeStmt( hSTMT, SQL_DROP );
+	odbc_statement_release( dbcontext, stmt, 0 );
 	return 0;
 }
 
+/*
+ * odbc_db_runquery
+ */
+
+int odbc_db_runquery( mvDatabase db, const char *query, int query_length, mvVariableList list, int entries )
+{
+	int result;
+	LONGLONG start, rows;
+	ODBCDatabase *dbcontext;
+
+	dbcontext	= ( ODBCDatabase * ) mvDatabase_data( db );
+	rows		= dbcontext->stats.rows;
+
+	if ( dbcontext->slowlog )	memset( dbcontext->statement_ticks, 0, sizeof( dbcontext->statement_ticks ) );
+
+	start	= odbc_timer();
+	result	= odbc_runquery( db, query, query_length, list, entries );
+
+	odbc_stats_record( dbcontext, ODBC_PHASE_QUERY, start );
+
+	if ( dbcontext->slowlog )	odbc_slowlog( dbcontext, "MvQUERY", query, query_length, list, result, dbcontext->stats.rows - rows );
+
+	return result;
+}
+
 /*
  * odbc_db_error
  */
@@ -814,21 +7448,79 @@ const char *odbc_db_error( mvDatabase db )
 {
 	ODBCDatabase *dbcontext;
 
-	dbcontext = ( ODBCDatabase * ) mvDatabase_data( db );
-	return dbcontext->error;
-}
+	dbcontext = ( ODBCDatabase * ) mvDatabase_data( db );
+	return dbcontext->error;
+}
+
+/*
+ * odbc_dbview_close
+ */
+
+int	odbc_dbview_close( mvDatabaseView dbview )
+{
+	int i;
+	ODBCDatabaseView *viewcontext;
+
+	viewcontext = ( ODBCDatabaseView * ) mvDatabaseView_data( dbview );
+
+	if ( viewcontext->async_thread )
+	{
+		SQLCancel( viewcontext->hSTMT );
+		WaitForSingleObject( viewcontext->async_thread, INFINITE );
+		CloseHandle( viewcontext->async_thread );
+
+		mvProgram_Free( NULL, viewcontext->async_query );
+	}
+
+	if ( viewcontext->async_error )
+	{
+		mvProgram_Free( NULL, viewcontext->async_error );
+	}
+
+	if ( viewcontext->db->results_view == viewcontext )
+	{
+		viewcontext->db->results_view = NULL;
+	}
+
+	if ( viewcontext->db->firehose_view == viewcontext )
+	{
+		viewcontext->db->firehose_view = NULL;
+	}
+
+	if ( viewcontext->replica && viewcontext->replica->firehose_view == viewcontext )
+	{
+		viewcontext->replica->firehose_view = NULL;
+	}
+
+	odbc_view_detach( viewcontext );
+
+	if ( viewcontext->shape )
+	{
+		for ( i = 0; i < viewcontext->column_count && i < viewcontext->shape->column_count; i++ )
+		{
+			if ( viewcontext->columns[ i ]->observed_size > viewcontext->shape->columns[ i ].observed_size )
+			{
+				viewcontext->shape->columns[ i ].observed_size = viewcontext->columns[ i ]->observed_size;
+			}
+		}
+	}
+
+	if ( viewcontext->stmt )			odbc_statement_release( viewcontext->db, viewcontext->stmt, viewcontext->replica == NULL );
 
-/*
- * odbc_dbview_close
- */
+	if ( viewcontext->connection )
+	{
+		SQLFreeStmt( viewcontext->hSTMT, SQL_DROP );
+		odbc_pool_checkin( viewcontext->connection, 1 );
+	}
 
-int	odbc_dbview_close( mvDatabaseView dbview )
-{
-	ODBCDatabaseView *viewcontext;
+	if ( viewcontext->replica )			odbc_replica_release( viewcontext->replica );
 
-	viewcontext = ( ODBCDatabaseView * ) mvDatabaseView_data( dbview );
-	
-	if ( viewcontext->hSTMT )	SQLFreeStmt( viewcontext->hSTMT, SQL_DROP );
+	if ( viewcontext->arena )			odbc_arena_release( viewcontext->arena );
+	if ( viewcontext->shape )			odbc_shape_release( viewcontext->shape );
+	if ( viewcontext->store )			odbc_store_free( viewcontext->store );
+	if ( viewcontext->cached )			odbc_cache_release( viewcontext->cached );
+	if ( viewcontext->cache_key )		mvProgram_Free( NULL, viewcontext->cache_key );
+	if ( viewcontext->cache_tables )	mvProgram_Free( NULL, viewcontext->cache_tables );
 	mvProgram_Free( NULL, viewcontext );
 
 	return 1;
@@ -845,6 +7537,8 @@ int odbc_dbview_skip( mvDatabaseView dbview, int rows )
 
 	viewcontext = ( ODBCDatabaseView * ) mvDatabaseView_data( dbview );
 
+	if ( !odbc_view_ready( viewcontext ) )	return 0;
+
 	ok = odbc_load_row( viewcontext, viewcontext->recno->data_integer + rows );
 	mvDatabaseView_SetDirty( dbview );
 
@@ -862,6 +7556,8 @@ int odbc_dbview_go( mvDatabaseView dbview, int row )
 
 	viewcontext = ( ODBCDatabaseView * ) mvDatabaseView_data( dbview );
 
+	if ( !odbc_view_ready( viewcontext ) )	return 0;
+
 	ok = odbc_load_row( viewcontext, row );
 	mvDatabaseView_SetDirty( dbview );
 
@@ -874,25 +7570,21 @@ int odbc_dbview_go( mvDatabaseView dbview, int row )
 
 int odbc_dbview_revealstructureagg( mvDatabaseView dbview, mvVariable **array )
 {
-	SQLSMALLINT i, numcols;
-	char szColName[ 128 ];
-	SQLSMALLINT cbColName, fSQLType, ibScale, fNullable;
-	SQLUINTEGER cbColDef;
-	ODBCDatabase *dbcontext;
+	int i;
+	ODBCColumnInfo *info;
 	ODBCDatabaseView *viewcontext;
 	mvVariable var_entry, var_name, var_type, var_len, var_dec;
 
 	viewcontext = ( ODBCDatabaseView * ) mvDatabaseView_data( dbview );
-	dbcontext	= ( ODBCDatabase * ) mvDatabase_data( mvDatabaseView_Database( dbview ) );
 
-	if ( SQLNumResultCols( viewcontext->hSTMT, &numcols ) != SQL_SUCCESS )	return odbc_error( dbcontext, "SQLNumResultCols: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
-	
-	for ( i = 1; i <= numcols; i++ )
+	if ( viewcontext->shape == NULL )
 	{
-		if ( SQLDescribeCol( viewcontext->hSTMT, i, szColName, sizeof( szColName ), &cbColName, &fSQLType, &cbColDef, &ibScale, &fNullable ) == SQL_ERROR )
-		{
-			return odbc_error( dbcontext, "SQLDescribeCol: ", viewcontext->hSTMT, SQL_HANDLE_STMT );
-		}
+		return 0;
+	}
+
+	for ( i = 1; i <= viewcontext->shape->column_count; i++ )
+	{
+		info		= &viewcontext->shape->columns[ i - 1 ];
 
 		var_entry	= mvVariable_Array_Element( i, *array, 1 );
 		var_name	= mvVariable_Struct_Member( "FIELD_NAME",	10,	var_entry, 1 );
@@ -900,9 +7592,9 @@ int odbc_dbview_revealstructureagg( mvDatabaseView dbview, mvVariable **array )
 		var_len		= mvVariable_Struct_Member( "FIELD_LEN",	9,	var_entry, 1 );
 		var_dec		= mvVariable_Struct_Member( "FIELD_DEC",	9,	var_entry, 1 );
 
-		mvVariable_SetValue( var_name, szColName, cbColName );
+		mvVariable_SetValue( var_name, ( const char * ) info->name, info->name_length );
 
-		switch ( fSQLType )
+		switch ( info->sql_type )
 		{
 			case SQL_DECIMAL		:
 			case SQL_NUMERIC		:
@@ -924,8 +7616,8 @@ int odbc_dbview_revealstructureagg( mvDatabaseView dbview, mvVariable **array )
 			default					: mvVariable_SetValue( var_type, "C", 1 );	break;
 		}
 
-		mvVariable_SetValue_Integer( var_len, cbColDef );
-		mvVariable_SetValue_Integer( var_dec, ibScale );
+		mvVariable_SetValue_Integer( var_len, info->precision );
+		mvVariable_SetValue_Integer( var_dec, info->scale );
 	}
 
 	return 1;
@@ -949,6 +7641,8 @@ int odbc_dbvar_getvalue_int( mvDatabaseVariable dbvar, int *value )
 	ODBCDatabaseVariable *var;
 
 	var = ( ODBCDatabaseVariable * ) mvDatabaseVariable_data( dbvar );
+	if ( !odbc_view_ready( ( ODBCDatabaseView * ) mvDatabaseView_data( mvDatabaseVariable_DatabaseView( dbvar ) ) ) )	return 0;
+
 	if ( var->type == ODBC_INTEGER )
 	{
 		if ( var->cbData == SQL_NULL_DATA || var->cbData == SQL_NO_DATA )	return 0;	// All NULL values go through dbvar_getvalue_string
@@ -969,6 +7663,8 @@ int odbc_dbvar_getvalue_double( mvDatabaseVariable dbvar, double *value )
 	ODBCDatabaseVariable *var;
 
 	var = ( ODBCDatabaseVariable * ) mvDatabaseVariable_data( dbvar );
+	if ( !odbc_view_ready( ( ODBCDatabaseView * ) mvDatabaseView_data( mvDatabaseVariable_DatabaseView( dbvar ) ) ) )	return 0;
+
 	if ( var->type == ODBC_DOUBLE )
 	{
 		if ( var->cbData == SQL_NULL_DATA || var->cbData == SQL_NO_DATA )	return 0;	// All NULL values go through dbvar_getvalue_string
@@ -986,113 +7682,20 @@ int odbc_dbvar_getvalue_double( mvDatabaseVariable dbvar, double *value )
 
 int odbc_dbvar_getvalue_string( mvDatabaseVariable dbvar, char **value, int *value_length, int *value_del )
 {
-	SQLRETURN result;
-	SQLINTEGER blob_len;
-	char *buffer, *temp_buffer;
-	int buffer_size;
 	ODBCDatabaseVariable *var;
 
-	var = ( ODBCDatabaseVariable * ) mvDatabaseVariable_data( dbvar );
-	if ( var->cbData == SQL_NULL_DATA )
+	var			= ( ODBCDatabaseVariable * ) mvDatabaseVariable_data( dbvar );
+	*value_del	= 0;
+
+	if ( !odbc_view_ready( ( ODBCDatabaseView * ) mvDatabaseView_data( mvDatabaseVariable_DatabaseView( dbvar ) ) ) )
 	{
 		*value			= "";
 		*value_length	= 0;
-		*value_del		= 0;
-
-		return 1;
-	}
-	else if ( var->type == ODBC_STRING )
-	{
-		*value			= var->data_string;
-		*value_length	= var->cbData;
-		*value_del		= 0;
-
-		return 1;
-	}
-	else if ( var->type == ODBC_BLOB )
-	{
-		buffer_size		= 512;
-		buffer			= ( char * ) mvProgram_Allocate( NULL, buffer_size + 1 + 1 ); /* The extra byte is required because an Oracle developer can't count */
-
-		result			= SQLGetData( var->data_blob_stmt, var->data_blob_col, SQL_C_CHAR, buffer, buffer_size + 1, &blob_len );
-
-		if ( result == SQL_ERROR )
-		{
-			/* Call odbc_error for logging */
-			odbc_error( ( ODBCDatabase * ) mvDatabase_data( mvDatabaseView_Database( mvDatabaseVariable_DatabaseView( dbvar ) ) ),
-				        "SQLGetData: ", var->data_blob_stmt, SQL_HANDLE_STMT );
-
-			mvProgram_Free( NULL, buffer );
-
-			*value			= "";
-			*value_length	= 0;
-			*value_del		= 0;
-
-			return 1;
-		}
-		else if ( result == SQL_NO_DATA || blob_len == SQL_NULL_DATA || blob_len == SQL_NO_TOTAL )
-		{
-			mvProgram_Free( NULL, buffer );
-
-			*value			= "";
-			*value_length	= 0;
-			*value_del		= 0;
-
-			return 1;
-		}
-		else if ( result == SQL_SUCCESS )
-		{
-			*value			= buffer;
-			*value_length	= blob_len;
-			*value_del		= 1;
-		}
-		else if ( result == SQL_SUCCESS_WITH_INFO )
-		{
-			if ( blob_len == SQL_NO_TOTAL )
-			{
-				/* Eventually we may want to modify this code to loop until we run out of data */
-
-				*value			= buffer;
-				*value_length	= MIVA_LENGTH_ASCIZ;
-				*value_del		= 1;
-			}
-			else
-			{
-				temp_buffer		= mvProgram_Allocate( NULL, blob_len + 1 + 1 ); /* The extra byte is required because an Oracle developer can't count */
-
-				memcpy( temp_buffer, buffer, buffer_size );
-				mvProgram_Free( NULL, buffer );
-
-				buffer			= temp_buffer;
-
-				if ( SQLGetData( var->data_blob_stmt, var->data_blob_col, SQL_C_CHAR, &buffer[ buffer_size ], blob_len - buffer_size + 1, NULL ) != SQL_SUCCESS )
-				{
-					mvProgram_Free( NULL, buffer );
-
-					*value			= "";
-					*value_length	= 0;
-					*value_del		= 0;
-
-					return 1;				
-				}
 
-				*value			= buffer;
-				*value_length	= blob_len;
-				*value_del		= 1;
-			}
-		}
-
-		odbc_log( ( ODBCDatabase * ) mvDatabase_data( mvDatabaseView_Database( mvDatabaseVariable_DatabaseView( dbvar ) ) ),
-				  "+++ BLOB data for column %d: length = %d, data = '%.*s'\n",
-				  var->column,
-				  *value_length,
-				  *value_length < 4096 ? *value_length : 4096,
-				  *value );
-
-		return 1;
+		return 0;
 	}
 
-	return 0;
+	return odbc_variable_string( ( ODBCDatabase * ) mvDatabase_data( mvDatabaseView_Database( mvDatabaseVariable_DatabaseView( dbvar ) ) ), var, value, value_length );
 }
 
 /*
@@ -1105,8 +7708,9 @@ void odbc_dbvar_cleanup( mvDatabaseVariable dbvar )
 
 	var = ( ODBCDatabaseVariable * ) mvDatabaseVariable_data( dbvar );
 
-	if ( var->data_string )	mvProgram_Free( NULL, var->data_string );
-	mvProgram_Free( NULL, var );
+	if ( var->blob )	mvProgram_Free( NULL, var->blob );
+
+	odbc_arena_release( var->arena );
 }
 
 /*
@@ -1144,10 +7748,15 @@ int odbc_db_commit( mvDatabase db )
 	ODBCDatabase *dbcontext;
 
 	dbcontext					= ( ODBCDatabase * ) mvDatabase_data( db );
+	if ( !odbc_firehose_yield( dbcontext ) )																	return 0;
+	if ( !odbc_batch_flush( dbcontext ) )																		return 0;
 	if ( SQLEndTran( SQL_HANDLE_DBC, dbcontext->hDBC, SQL_COMMIT ) == SQL_ERROR )	return odbc_error( dbcontext, "SQLEndTran: ", dbcontext->hDBC, SQL_HANDLE_DBC );
+	odbc_cache_committed( dbcontext );
 	dbcontext->in_transaction	= 0;
+	dbcontext->group_pending	= 0;
+	dbcontext->last_write		= GetTickCount64();
 
-	return 1;
+	return odbc_autocommit_mode( dbcontext );
 }
 
 /*
@@ -1159,10 +7768,15 @@ int odbc_db_rollback( mvDatabase db )
 	ODBCDatabase *dbcontext;
 
 	dbcontext					= ( ODBCDatabase * ) mvDatabase_data( db );
+	if ( !odbc_firehose_yield( dbcontext ) )																	return 0;
+	if ( dbcontext->batch )																						odbc_batch_reset( dbcontext, 0 );
+	if ( !dbcontext->in_transaction && !odbc_group_commit( dbcontext ) )										return 0;
 	if ( SQLEndTran( SQL_HANDLE_DBC, dbcontext->hDBC, SQL_ROLLBACK ) == SQL_ERROR )	return odbc_error( dbcontext, "SQLEndTran: ", dbcontext->hDBC, SQL_HANDLE_DBC );
 	dbcontext->in_transaction	= 0;
+	dbcontext->cache_written[ 0 ]	= '\0';
+	dbcontext->cache_written_all	= 0;
 
-	return 1;
+	return odbc_autocommit_mode( dbcontext );
 }
 
 /*
@@ -1174,7 +7788,137 @@ int odbc_db_transact( mvDatabase db )
 	ODBCDatabase *dbcontext;
 
 	dbcontext					= ( ODBCDatabase * ) mvDatabase_data( db );
+	if ( !odbc_firehose_yield( dbcontext ) )	return 0;
+	if ( !odbc_batch_flush( dbcontext ) )		return 0;
+	if ( !odbc_group_commit( dbcontext ) )		return 0;
+	odbc_writebehind_flush( dbcontext );
 	dbcontext->in_transaction	= 1;
+	dbcontext->last_write		= GetTickCount64();
+
+	return odbc_autocommit_mode( dbcontext );
+}
+
+/*
+ * odbc_db_report
+ *
+ * Writes the connection's cache statistics to the named data file, or to the log if no file is given
+ */
+
+int odbc_db_report( mvDatabase db, ODBCDatabase *dbcontext, const char *parameter, int parameter_length )
+{
+	int length;
+	unsigned int lookups;
+	mvFile file;
+	char buffer[ 2048 ];
+
+	lookups	= dbcontext->param_cache_hits + dbcontext->param_cache_misses;
+	length	= sprintf( buffer, "Statement cache: size = %d, entries = %d, hits = %u, misses = %u, direct = %u\n"
+							   "Parameter cache: size = %d, entries = %d, hits = %u, misses = %u, hit rate = %.1f%%, describe = %s\n"
+							   "Result shape cache: size = %d, entries = %d, hits = %u, misses = %u\n"
+							   "Allocations: count = %u, bytes = %u, views = %u, views with one per variable = %u\n",
+					   dbcontext->stmt_cache_size,
+					   dbcontext->stmt_count,
+					   dbcontext->stmt_hits,
+					   dbcontext->stmt_misses,
+					   dbcontext->stmt_direct_count,
+					   dbcontext->param_cache_size,
+					   dbcontext->param_cache_count,
+					   dbcontext->param_cache_hits,
+					   dbcontext->param_cache_misses,
+					   lookups ? ( 100.0 * dbcontext->param_cache_hits ) / lookups : 0.0,
+					   dbcontext->describe_unsupported ? "unsupported" : "supported",
+					   dbcontext->shape_cache_size,
+					   dbcontext->shape_cache_count,
+					   dbcontext->shape_cache_hits,
+					   dbcontext->shape_cache_misses,
+					   dbcontext->allocations,
+					   dbcontext->allocation_bytes,
+					   dbcontext->view_allocations,
+					   dbcontext->view_variable_allocations );
+
+	if ( dbcontext->result_cache )
+	{
+		EnterCriticalSection( &odbc_cache_lock );
+		length += sprintf( &buffer[ length ], "Result cache: ttl = %d s, budget = %d, entries = %d, bytes = %d, hits = %u, misses = %u, shared hits = %d, invalidations = %u, shared slots = %d\n",
+						   dbcontext->result_cache,
+						   odbc_cache_budget,
+						   odbc_cache_count,
+						   odbc_cache_bytes,
+						   odbc_cache_hits,
+						   odbc_cache_misses,
+						   ( int ) odbc_cache_shared_hits,
+						   odbc_cache_invalidations,
+						   odbc_shared ? odbc_shared->slot_count : 0 );
+		LeaveCriticalSection( &odbc_cache_lock );
+	}
+
+	if ( dbcontext->replicas )
+	{
+		length += sprintf( &buffer[ length ], "Read replicas: count = %d, routing = %s, sticky = %d ms\n",
+						   dbcontext->replica_count,
+						   dbcontext->replica_routing ? "on" : "off",
+						   dbcontext->replica_sticky );
+	}
+
+	if ( dbcontext->writebehind )
+	{
+		length += sprintf( &buffer[ length ], "Write-behind: queue = %d, queued = %d, completed = %d, failures = %d\n",
+						   dbcontext->writebehind->capacity,
+						   ( int ) ( dbcontext->writebehind->tail - dbcontext->writebehind->head ),
+						   ( int ) dbcontext->writebehind->completed,
+						   ( int ) dbcontext->writebehind->failures );
+	}
+
+	if ( parameter_length == 0 )
+	{
+		odbc_log_data( dbcontext, buffer, length - 1 );
+		return 1;
+	}
+
+	if ( ( file = mvFile_Open( mvDatabase_Program( db ), MVF_DATA, parameter, parameter_length, MVF_MODE_CREATE | MVF_MODE_APPEND | MVF_MODE_WRITE ) ) == NULL )
+	{
+		strcpy( dbcontext->error, "Unable to open statistics file" );
+		return 0;
+	}
+
+	mvFile_Write( file, buffer, length );
+	mvFile_Close( file );
+
+	return 1;
+}
+
+/*
+ * odbc_db_stats
+ *
+ * Writes the connection's and the process's latency histograms as JSON to the named data file, or to the log
+ */
+
+int odbc_db_stats( mvDatabase db, ODBCDatabase *dbcontext, const char *parameter, int parameter_length )
+{
+	int length;
+	mvFile file;
+	char buffer[ 16384 ];
+
+	length	= sprintf( buffer, "{\"connection\":" );
+	length	+= odbc_stats_json( &buffer[ length ], &dbcontext->stats );
+	length	+= sprintf( &buffer[ length ], ",\"process\":" );
+	length	+= odbc_stats_json( &buffer[ length ], &odbc_stats );
+	length	+= sprintf( &buffer[ length ], "}\n" );
+
+	if ( parameter_length == 0 )
+	{
+		odbc_log_data( dbcontext, buffer, length - 1 );
+		return 1;
+	}
+
+	if ( ( file = mvFile_Open( mvDatabase_Program( db ), MVF_DATA, parameter, parameter_length, MVF_MODE_CREATE | MVF_MODE_APPEND | MVF_MODE_WRITE ) ) == NULL )
+	{
+		strcpy( dbcontext->error, "Unable to open statistics file" );
+		return 0;
+	}
+
+	mvFile_Write( file, buffer, length );
+	mvFile_Close( file );
 
 	return 1;
 }
@@ -1185,6 +7929,7 @@ int odbc_db_transact( mvDatabase db )
 
 int odbc_db_command( mvDatabase db, const char *command, int command_length, const char *parameter, int parameter_length )
 {
+	int i, ok;
 	ODBCDatabase *dbcontext;
 
 	dbcontext					= ( ODBCDatabase * ) mvDatabase_data( db );
@@ -1209,10 +7954,258 @@ int odbc_db_command( mvDatabase db, const char *command, int command_length, con
 			return 0;
 		}
 	}
-	else if ( command_length == 12 && !memcmp( command, "manualcommit", 12 ) )		dbcontext->autocommit	= 0;
-	else if ( command_length == 10 && !memcmp( command, "autocommit", 10 ) )		dbcontext->autocommit	= 1;
+	else if ( command_length == 7 && !memcmp( command, "slowlog", 7 ) )
+	{
+		if ( dbcontext->slowlog )
+		{
+			mvFile_Close( dbcontext->slowlog );
+			dbcontext->slowlog = NULL;
+		}
+
+		if ( parameter_length >= 3 && !memcmp( parameter, "off", 3 ) )
+		{
+			return 1;
+		}
+
+		if ( parameter_length == 0 || parameter[ 0 ] < '0' || parameter[ 0 ] > '9' )
+		{
+			strcpy( dbcontext->error, "Usage: slowlog <milliseconds> [file] | off" );
+			return 0;
+		}
+
+		dbcontext->slowlog_threshold = ( ( LONGLONG ) odbc_parameter_integer( parameter, parameter_length ) * odbc_timer_frequency ) / 1000;
+
+		for ( i = 0; i < parameter_length && parameter[ i ] >= '0' && parameter[ i ] <= '9'; i++ );
+		for ( ; i < parameter_length && parameter[ i ] == ' '; i++ );
+
+		if ( i == parameter_length )
+		{
+			parameter			= "slow.log";
+			parameter_length	= 8;
+			i					= 0;
+		}
+
+		if ( ( dbcontext->slowlog = mvFile_Open( mvDatabase_Program( db ), MVF_DATA, &parameter[ i ], parameter_length - i, MVF_MODE_CREATE | MVF_MODE_APPEND | MVF_MODE_WRITE ) ) == NULL )
+		{
+			strcpy( dbcontext->error, "Unable to open slow query log" );
+			return 0;
+		}
+	}
+	else if ( command_length == 12 && !memcmp( command, "manualcommit", 12 ) )
+	{
+		if ( !odbc_group_commit( dbcontext ) )	return 0;
+
+		dbcontext->autocommit			= 0;
+		return odbc_autocommit_mode( dbcontext );
+	}
+	else if ( command_length == 10 && !memcmp( command, "autocommit", 10 ) )
+	{
+		if ( !odbc_group_commit( dbcontext ) )	return 0;
+
+		dbcontext->autocommit			= 1;
+		dbcontext->autocommit_native	= 0;
+		dbcontext->group_commit_rows	= 0;
+		dbcontext->group_commit_ms		= 0;
+		return odbc_autocommit_mode( dbcontext );
+	}
+	else if ( command_length == 12 && !memcmp( command, "nativecommit", 12 ) )
+	{
+		if ( !odbc_group_commit( dbcontext ) )	return 0;
+
+		dbcontext->autocommit			= 1;
+		dbcontext->autocommit_native	= 1;
+		dbcontext->group_commit_rows	= 0;
+		dbcontext->group_commit_ms		= 0;
+		return odbc_autocommit_mode( dbcontext );
+	}
+	else if ( command_length == 11 && !memcmp( command, "groupcommit", 11 ) )
+	{
+		for ( i = 0; i < parameter_length && parameter[ i ] != ' '; i++ );
+		for ( ; i < parameter_length && parameter[ i ] == ' '; i++ );
+
+		dbcontext->autocommit			= 1;
+		dbcontext->autocommit_native	= 0;
+		dbcontext->group_commit_rows	= odbc_parameter_integer( parameter, parameter_length );
+		dbcontext->group_commit_ms		= odbc_parameter_integer( &parameter[ i ], parameter_length - i );
+
+		if ( !odbc_group_commit( dbcontext ) )	return 0;
+		return odbc_autocommit_mode( dbcontext );
+	}
 	else if ( command_length == 8 && !memcmp( command, "truncate", 8 ) )			dbcontext->truncate		= 1;
 	else if ( command_length == 11 && !memcmp( command, "forwardonly", 11 ) )		dbcontext->forwardonly	= 1;
+	else if ( command_length == 8 && !memcmp( command, "firehose", 8 ) )			dbcontext->firehose		= 1;
+	else if ( command_length == 12 && !memcmp( command, "staticcursor", 12 ) )		dbcontext->firehose		= 0;
+	else if ( command_length == 13 && !memcmp( command, "firehosestore", 13 ) )
+	{
+		dbcontext->firehose_store	= odbc_parameter_integer( parameter, parameter_length );
+		dbcontext->store_spill		= 0;
+	}
+	else if ( command_length == 11 && !memcmp( command, "resultstore", 11 ) )
+	{
+		dbcontext->firehose_store	= odbc_parameter_integer( parameter, parameter_length );
+		dbcontext->store_spill		= ( dbcontext->firehose_store > 0 );
+		dbcontext->firehose			= 1;
+	}
+	else if ( command_length == 11 && !memcmp( command, "materialize", 11 ) )
+	{
+		dbcontext->materialize		= 1;
+		dbcontext->firehose			= 1;
+	}
+	else if ( command_length == 13 && !memcmp( command, "nomaterialize", 13 ) )		dbcontext->materialize	= 0;
+	else if ( command_length == 11 && !memcmp( command, "resultcache", 11 ) )
+	{
+		/* Only firehose views fill their row store in a form that can be cached */
+
+		dbcontext->result_cache		= odbc_parameter_integer( parameter, parameter_length );
+		dbcontext->firehose			= 1;
+	}
+	else if ( command_length == 13 && !memcmp( command, "noresultcache", 13 ) )		dbcontext->result_cache	= 0;
+	else if ( command_length == 10 && !memcmp( command, "cacheflush", 10 ) )
+	{
+		odbc_shared_written( NULL );
+		odbc_cache_flush();
+	}
+	else if ( command_length == 11 && !memcmp( command, "sharedcache", 11 ) )
+	{
+		if ( odbc_shared == NULL )
+		{
+			odbc_shared_size	= odbc_parameter_integer( parameter, parameter_length );
+			odbc_shared_failed	= 0;
+		}
+
+		return odbc_shared_attach( dbcontext ) || ( odbc_shared_size == 0 );
+	}
+	else if ( command_length == 15 && !memcmp( command, "resultcachesize", 15 ) )
+	{
+		EnterCriticalSection( &odbc_cache_lock );
+
+		odbc_cache_budget = odbc_parameter_integer( parameter, parameter_length );
+		odbc_cache_trim( odbc_cache_budget );
+
+		LeaveCriticalSection( &odbc_cache_lock );
+	}
+	else if ( command_length == 7 && !memcmp( command, "replica", 7 ) )
+	{
+		if		( parameter_length == 3 && !memcmp( parameter, "off", 3 ) )	dbcontext->replica_routing	= 0;
+		else if	( parameter_length == 2 && !memcmp( parameter, "on", 2 ) )	dbcontext->replica_routing	= ( dbcontext->replicas != NULL );
+		else if	( parameter_length == 0 )
+		{
+			strcpy( dbcontext->error, "Usage: replica <dsn or connection string> | on | off" );
+			return 0;
+		}
+		else
+		{
+			return odbc_replica_add( dbcontext, parameter, parameter_length );
+		}
+	}
+	else if ( command_length == 13 && !memcmp( command, "replicasticky", 13 ) )	dbcontext->replica_sticky	= odbc_parameter_integer( parameter, parameter_length );
+	else if ( command_length == 5 && !memcmp( command, "async", 5 ) )
+	{
+		if ( parameter_length >= 3 && !memcmp( parameter, "off", 3 ) )
+		{
+			odbc_writebehind_stop( dbcontext );
+		}
+		else if ( parameter_length >= 2 && !memcmp( parameter, "on", 2 ) )
+		{
+			for ( i = 2; i < parameter_length && parameter[ i ] == ' '; i++ );
+
+			return odbc_writebehind_start( dbcontext, odbc_parameter_integer( &parameter[ i ], parameter_length - i ) );
+		}
+		else
+		{
+			strcpy( dbcontext->error, "Usage: async on [queue size] | off" );
+			return 0;
+		}
+	}
+	else if ( command_length == 10 && !memcmp( command, "asyncflush", 10 ) )		odbc_writebehind_flush( dbcontext );
+	else if ( command_length == 9 && !memcmp( command, "asyncopen", 9 ) )			dbcontext->async_open	= 1;
+	else if ( command_length == 11 && !memcmp( command, "noasyncopen", 11 ) )		dbcontext->async_open	= 0;
+	else if ( command_length == 8 && !memcmp( command, "prefetch", 8 ) )			dbcontext->prefetch		= 1;
+	else if ( command_length == 10 && !memcmp( command, "noprefetch", 10 ) )		dbcontext->prefetch		= 0;
+	else if ( command_length == 8 && !memcmp( command, "fastskip", 8 ) )			dbcontext->fast_skip	= odbc_parameter_integer( parameter, parameter_length );
+	else if ( command_length == 6 && !memcmp( command, "rowset", 6 ) )				dbcontext->rowset_size	= odbc_parameter_integer( parameter, parameter_length );
+	else if ( command_length == 9 && !memcmp( command, "stmtcache", 9 ) )
+	{
+		dbcontext->stmt_cache_size = odbc_parameter_integer( parameter, parameter_length );
+		odbc_statement_trim( dbcontext, dbcontext->stmt_cache_size );
+	}
+	else if ( command_length == 10 && !memcmp( command, "execdirect", 10 ) )			dbcontext->stmt_direct	= 1;
+	else if ( command_length == 13 && !memcmp( command, "alwaysprepare", 13 ) )		dbcontext->stmt_direct	= 0;
+	else if ( command_length == 14 && !memcmp( command, "stmtcacheflush", 14 ) )		odbc_statement_trim( dbcontext, 0 );
+	else if ( command_length == 10 && !memcmp( command, "paramcache", 10 ) )
+	{
+		dbcontext->param_cache_size = odbc_parameter_integer( parameter, parameter_length );
+		odbc_param_cache_trim( dbcontext, dbcontext->param_cache_size );
+	}
+	else if ( command_length == 10 && !memcmp( command, "shapecache", 10 ) )
+	{
+		dbcontext->shape_cache_size = odbc_parameter_integer( parameter, parameter_length );
+		odbc_shape_cache_trim( dbcontext, dbcontext->shape_cache_size );
+	}
+	else if ( command_length == 10 && !memcmp( command, "inlineblob", 10 ) )
+	{
+		dbcontext->inline_blob = odbc_parameter_integer( parameter, parameter_length );
+	}
+	else if ( command_length == 9 && !memcmp( command, "stringmax", 9 ) )
+	{
+		dbcontext->string_max = odbc_parameter_integer( parameter, parameter_length );
+	}
+	else if ( command_length == 11 && !memcmp( command, "stringlearn", 11 ) )
+	{
+		dbcontext->string_learn = odbc_parameter_integer( parameter, parameter_length );
+	}
+	else if ( command_length == 7 && !memcmp( command, "blobmax", 7 ) )
+	{
+		dbcontext->blob_max = odbc_parameter_integer( parameter, parameter_length );
+	}
+	else if ( command_length == 10 && !memcmp( command, "cachestats", 10 ) )			return odbc_db_report( db, dbcontext, parameter, parameter_length );
+	else if ( command_length == 5 && !memcmp( command, "stats", 5 ) )					return odbc_db_stats( db, dbcontext, parameter, parameter_length );
+	else if ( command_length == 6 && !memcmp( command, "nopool", 6 ) )				dbcontext->nopool		= 1;
+	else if ( command_length == 8 && !memcmp( command, "poolsize", 8 ) )
+	{
+		EnterCriticalSection( &odbc_pool_lock );
+		odbc_pool_size = odbc_parameter_integer( parameter, parameter_length );
+		LeaveCriticalSection( &odbc_pool_lock );
+	}
+	else if ( command_length == 8 && !memcmp( command, "poolidle", 8 ) )
+	{
+		EnterCriticalSection( &odbc_pool_lock );
+		odbc_pool_idle_timeout = odbc_parameter_integer( parameter, parameter_length );
+		LeaveCriticalSection( &odbc_pool_lock );
+	}
+	else if ( command_length == 12 && !memcmp( command, "poollifetime", 12 ) )
+	{
+		EnterCriticalSection( &odbc_pool_lock );
+		odbc_pool_lifetime = odbc_parameter_integer( parameter, parameter_length );
+		LeaveCriticalSection( &odbc_pool_lock );
+	}
+	else if ( command_length == 10 && !memcmp( command, "batchbegin", 10 ) )
+	{
+		if ( dbcontext->batch == NULL )
+		{
+			dbcontext->batch = ( ODBCBatch * ) odbc_allocate( dbcontext, sizeof( ODBCBatch ) );
+			memset( dbcontext->batch, 0, sizeof( ODBCBatch ) );
+		}
+		else if ( !odbc_batch_flush( dbcontext ) )
+		{
+			return 0;
+		}
+
+		if ( ( dbcontext->batch->size = odbc_parameter_integer( parameter, parameter_length ) ) == 0 )
+		{
+			dbcontext->batch->size = 100;
+		}
+	}
+	else if ( command_length == 10 && !memcmp( command, "batchflush", 10 ) )
+	{
+		if ( dbcontext->batch )
+		{
+			ok = odbc_batch_flush( dbcontext );
+			odbc_batch_free( dbcontext );
+
+			return ok;
+		}
+	}
 	
 	return 1;
 }
@@ -1273,7 +8266,56 @@ MV_EL_Database *miva_database_library()
 		odbc_db_command
 	};
 
+	if ( InterlockedExchange( &odbc_pool_prewarmed, 1 ) == 0 )
+	{
+		odbc_pool_prewarm();
+	}
+
 	return &miva_dblib;
 }
 
+/*
+ * DllMain
+ */
+
+BOOL WINAPI DllMain( HINSTANCE hInstance, DWORD dwReason, LPVOID lpReserved )
+{
+	LARGE_INTEGER frequency;
+
+	switch ( dwReason )
+	{
+		case DLL_PROCESS_ATTACH :
+		{
+			hODBCInstance			= hInstance;
+
+			QueryPerformanceFrequency( &frequency );
+			odbc_timer_frequency	= frequency.QuadPart;
+
+			InitializeCriticalSection( &odbc_pool_lock );
+			InitializeCriticalSection( &odbc_cache_lock );
+
+			odbc_pool_size			= odbc_pool_setting( "MVDODBC_POOL_SIZE",		odbc_pool_size );
+			odbc_pool_idle_timeout	= odbc_pool_setting( "MVDODBC_POOL_IDLE",		odbc_pool_idle_timeout );
+			odbc_pool_lifetime		= odbc_pool_setting( "MVDODBC_POOL_LIFETIME",	odbc_pool_lifetime );
+			odbc_cache_budget		= odbc_pool_setting( "MVDODBC_CACHE_SIZE",		odbc_cache_budget );
+			odbc_shared_size		= odbc_pool_setting( "MVDODBC_SHARED_CACHE",	odbc_shared_size );
+
+			break;
+		}
+		case DLL_PROCESS_DETACH :
+		{
+			odbc_cache_flush();
+
+			if ( odbc_shared )		UnmapViewOfFile( odbc_shared );
+			if ( odbc_shared_map )	CloseHandle( odbc_shared_map );
+
+			DeleteCriticalSection( &odbc_cache_lock );
+			DeleteCriticalSection( &odbc_pool_lock );
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
 